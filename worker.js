@@ -1,7 +1,10 @@
 // 常量定义
 const RATE_LIMIT = {
     WINDOW_SIZE: 60, // 60秒窗口
-    MAX_REQUESTS: 100 // 每个窗口最大请求数
+    MAX_REQUESTS: 100, // 匿名访问（仪表盘等）每 IP 每个窗口最大请求数
+    AGENT_MAX_REQUESTS: 120, // 上报客户端每 machine_id 每个窗口最大请求数
+    AGENT_IP_MAX_REQUESTS: 6000, // 上报接口每 IP 每个窗口最大请求数（允许大量客户端共用出口 IP）
+    MAX_TRACKED_KEYS: 50000 // 每个 isolate 最多跟踪的 key 数，超出时淘汰最久未访问的
 };
 
 const ERROR_MESSAGES = {
@@ -12,9 +15,202 @@ const ERROR_MESSAGES = {
     SERVER_ERROR: '服务器内部错误'
 };
 
-// 在常量定义部分添加数据保留时间配置
+// 在常量定义部分添加数据保留时间配置（由 Cron Trigger 定时执行，不在上报路径上）
 const DATA_RETENTION = {
-    MAX_RECORDS_PER_CLIENT: 10  // 每个客户端保留的最大记录数
+    RAW_SECONDS: 2 * 24 * 60 * 60,            // 原始 status 数据保留 2 天
+    ROLLUP_1M_SECONDS: 14 * 24 * 60 * 60,     // 1 分钟汇总保留 14 天
+    ROLLUP_1H_SECONDS: 365 * 24 * 60 * 60,    // 1 小时汇总保留 1 年
+    CLIENT_EXPIRE_SECONDS: 30 * 24 * 60 * 60, // 超过 30 天未上报的客户端整体删除
+    DELETE_CHUNK_SIZE: 5000,                  // 每条 DELETE 最多删除的行数
+    MAX_CHUNKS_PER_RUN: 20,                   // 每个表每次定时任务最多执行的 DELETE 次数
+    ROLLUP_MAX_SPAN: 6 * 60 * 60              // 每次定时任务最多汇总的原始数据时长（秒）
+};
+
+// 汇总表中的指标：[汇总列名前缀, status 表上的取值表达式]
+const ROLLUP_METRICS = [
+    ['cpu_percent', 'cpu_percent'],
+    ['mem_used', 'mem_used'],
+    ['swap_used', 'swap_total - swap_free'],
+    ['disk_used_kb', 'disks_total_kb - disks_avail_kb'],
+    ['net_tx', 'net_tx'],
+    ['net_rx', 'net_rx'],
+    ['process_count', 'process_count'],
+    ['connection_count', 'connection_count']
+];
+
+const ROLLUP_COLUMNS = [
+    'client_id', 'bucket_ts', 'samples',
+    ...ROLLUP_METRICS.flatMap(([metric]) => [`${metric}_avg`, `${metric}_max`])
+];
+
+// 原始数据按分钟汇总，重复执行时以 REPLACE 覆盖同一分钟
+const SQL_ROLLUP_1M = `
+    INSERT OR REPLACE INTO status_1m (${ROLLUP_COLUMNS.join(', ')})
+    SELECT client_id, insert_utc_ts - insert_utc_ts % 60, COUNT(*),
+        ${ROLLUP_METRICS.map(([, expr]) => `AVG(${expr}), MAX(${expr})`).join(',\n        ')}
+    FROM status
+    WHERE insert_utc_ts >= ? AND insert_utc_ts < ?
+    GROUP BY client_id, insert_utc_ts - insert_utc_ts % 60
+`;
+
+// 分钟汇总按小时再汇总，平均值按样本数加权
+const SQL_ROLLUP_1H = `
+    INSERT OR REPLACE INTO status_1h (${ROLLUP_COLUMNS.join(', ')})
+    SELECT client_id, bucket_ts - bucket_ts % 3600, SUM(samples),
+        ${ROLLUP_METRICS.map(([metric]) => `SUM(${metric}_avg * samples) / SUM(samples), MAX(${metric}_max)`).join(',\n        ')}
+    FROM status_1m
+    WHERE bucket_ts >= ? AND bucket_ts < ?
+    GROUP BY client_id, bucket_ts - bucket_ts % 3600
+`;
+
+// 客户端 ID 缓存配置
+const CLIENT_CACHE = {
+    MAX_ENTRIES: 10000  // 每个 isolate 缓存的 machine_id -> client_id 映射数
+};
+
+// status 表中由客户端上报的指标字段及其解析方式
+const STATUS_FIELDS = [
+    ['uptime', 'int'],
+    ['cpu_percent', 'float'],
+    ['net_tx', 'int'],
+    ['net_rx', 'int'],
+    ['disks_total_kb', 'int'],
+    ['disks_avail_kb', 'int'],
+    ['cpu_num_cores', 'int'],
+    ['mem_total', 'float'],
+    ['mem_free', 'float'],
+    ['mem_used', 'float'],
+    ['swap_total', 'float'],
+    ['swap_free', 'float'],
+    ['process_count', 'int'],
+    ['connection_count', 'int'],
+    ['cpu_model', 'string'],
+    ['mem_available', 'float'],
+    ['mem_dirty', 'float'],
+    ['mem_writeback', 'float'],
+    ['mem_slab', 'float'],
+    ['mem_shmem', 'float'],
+    ['hugepages_total', 'int'],
+    ['hugepages_free', 'int'],
+    ['pgfault_rate', 'float'],
+    ['pgmajfault_rate', 'float'],
+    ['pswpin_rate', 'float'],
+    ['pswpout_rate', 'float'],
+    ['oom_kill', 'int'],
+    ['numa_mem', 'string'],
+    ['tcp_retrans_rate', 'float'],
+    ['tcp_retrans_pct', 'float'],
+    ['tcp_out_rst_rate', 'float'],
+    ['tcp_estab_reset_rate', 'float'],
+    ['listen_overflow_rate', 'float'],
+    ['listen_drop_rate', 'float'],
+    ['udp_rcvbuf_err_rate', 'float'],
+    ['syncookie_sent_rate', 'float'],
+    ['syncookie_recv_rate', 'float']
+];
+
+const STATUS_COLUMNS = [
+    'client_id', 'name', 'system', 'location', 'insert_utc_ts',
+    ...STATUS_FIELDS.map(([field]) => field),
+    'ip_address', 'country_code'
+];
+
+// client 表的 UPSERT，一次往返完成新增或更新并返回 id
+const SQL_UPSERT_CLIENT = `
+    INSERT INTO client (machine_id, name) VALUES (?, ?)
+    ON CONFLICT(machine_id) DO UPDATE SET name = excluded.name
+    RETURNING id
+`;
+
+// status 插入语句：client_id 已缓存时直接绑定，否则在同一批次内按 machine_id 子查询
+const buildStatusInsert = (clientIdExpr) => `
+    INSERT INTO status (${STATUS_COLUMNS.join(', ')})
+    VALUES (${clientIdExpr}, ${STATUS_COLUMNS.slice(1).map(() => '?').join(', ')})
+    RETURNING id
+`;
+const SQL_INSERT_STATUS_BY_ID = buildStatusInsert('?');
+const SQL_INSERT_STATUS_BY_MACHINE_ID = buildStatusInsert('(SELECT id FROM client WHERE machine_id = ?)');
+
+// /status/latest 返回的列及缺省值，缺省值在 SQL 中填充
+const LATEST_DEFAULTS = {
+    name: '未命名',
+    location: '未知',
+    system: 'Unknown',
+    cpu_num_cores: 1,
+    country_code: 'xx',
+    cpu_model: 'Unknown CPU',
+    numa_mem: ''
+};
+
+// 需要填充缺省值的列，SQL 与推送数据共用同一规则
+const LATEST_COLUMNS = ['name', 'system', 'location', ...STATUS_FIELDS.map(([field]) => field), 'country_code'];
+
+const latestColumn = (column) => {
+    const fallback = LATEST_DEFAULTS[column];
+    if (typeof fallback === 'string') return `COALESCE(NULLIF(s.${column}, ''), '${fallback}') AS ${column}`;
+    if (fallback !== undefined) return `COALESCE(NULLIF(s.${column}, 0), ${fallback}) AS ${column}`;
+    return `COALESCE(s.${column}, 0) AS ${column}`;
+};
+
+// 通过 latest_status 直接定位每个客户端的最新一条，不再对 status 做全表聚合
+const SQL_LATEST_STATUS = `
+    SELECT
+        c.machine_id, s.id, s.client_id, s.insert_utc_ts, s.ip_address,
+        ${LATEST_COLUMNS.map(latestColumn).join(',\n        ')}
+    FROM latest_status l
+    JOIN status s ON s.id = l.status_id
+    JOIN client c ON c.id = l.client_id
+    ORDER BY l.insert_utc_ts DESC
+`;
+
+// latest_status 的版本号：任一客户端上报或客户端被删除都会改变
+const SQL_LATEST_VERSION = `
+    SELECT COUNT(*) AS client_count, MAX(status_id) AS max_status_id, MAX(insert_utc_ts) AS max_ts
+    FROM latest_status
+`;
+
+// 历史数据查询配置
+const HISTORY = {
+    MAX_POINTS: 1000,           // 单次返回的最大点数，超过时自动增大 step；同时限制了单次查询的内存占用
+    DEFAULT_RANGE: 60 * 60      // 未指定 from 时默认查询最近 1 小时
+};
+
+// 历史数据来源，按分辨率从细到粗排列
+const HISTORY_SOURCES = [
+    {
+        name: 'raw',
+        resolution: 1,
+        retention: DATA_RETENTION.RAW_SECONDS,
+        sql: (expr) => `
+            SELECT insert_utc_ts - insert_utc_ts % ? AS t, AVG(${expr}) AS avg, MAX(${expr}) AS max
+            FROM status
+            WHERE client_id = (SELECT id FROM client WHERE machine_id = ?)
+            AND insert_utc_ts >= ? AND insert_utc_ts < ?
+            GROUP BY t ORDER BY t
+        `
+    },
+    ...[['1m', 60, DATA_RETENTION.ROLLUP_1M_SECONDS], ['1h', 3600, DATA_RETENTION.ROLLUP_1H_SECONDS]].map(
+        ([name, resolution, retention]) => ({
+            name,
+            resolution,
+            retention,
+            sql: (expr, metric) => `
+                SELECT bucket_ts - bucket_ts % ? AS t,
+                    SUM(${metric}_avg * samples) / SUM(samples) AS avg, MAX(${metric}_max) AS max
+                FROM status_${name}
+                WHERE client_id = (SELECT id FROM client WHERE machine_id = ?)
+                AND bucket_ts >= ? AND bucket_ts < ?
+                GROUP BY t ORDER BY t
+            `
+        })
+    )
+];
+
+// SSE 推送配置
+const STATUS_STREAM = {
+    FLUSH_INTERVAL_MS: 1000,   // 合并该时间内的变化后统一推送
+    HEARTBEAT_MS: 25000,       // 心跳间隔，防止空闲连接被中间代理断开
+    RETRY_MS: 5000             // 浏览器断线重连间隔
 };
 
 // 添加 GitHub index.html 链接常量
@@ -26,6 +222,12 @@ let indexHtmlCache = {
     timestamp: 0
 };
 
+// /status/latest 的序列化响应快照，按 ETag 复用
+let latestStatusSnapshot = {
+    etag: null,
+    body: null
+};
+
 // 修改国家代码映射
 const COUNTRY_CODE_MAP = {
     'hk': 'cn',  // 香港映射到中国
@@ -41,6 +243,23 @@ const utils = {
         return required.every(field => data.has(field));
     },
 
+    // 上报数据支持表单和 JSON 两种编码，统一为与 FormData 相同的 get/has 语义（缺失字段返回 null）；
+    // 其他编码或无法解析的请求体按空数据处理，由数据验证返回 400
+    parseStatusBody: async (request) => {
+        const contentType = request.headers.get('Content-Type') || '';
+        if (contentType.includes('application/json')) {
+            const json = await request.json().catch(() => null);
+            if (!json || typeof json !== 'object' || Array.isArray(json)) return new URLSearchParams();
+            return new URLSearchParams(Object.entries(json)
+                .filter(([, value]) => value !== null && typeof value !== 'object')
+                .map(([key, value]) => [key, String(value)]));
+        }
+        if (contentType.includes('application/x-www-form-urlencoded') || contentType.includes('multipart/form-data')) {
+            return request.formData().catch(() => new URLSearchParams());
+        }
+        return new URLSearchParams();
+    },
+
     sanitizeString: (str) => {
         if (!str) return '';
         return str.replace(/[<>]/g, '').slice(0, 255);
@@ -55,6 +274,32 @@ const utils = {
         };
     },
 
+    getClientIp: (request) => {
+        return request.headers.get('CF-Connecting-IP') || 'unknown';
+    },
+
+    parseField: (value, type) => {
+        if (type === 'int') return parseInt(value) || 0;
+        if (type === 'float') return parseFloat(value) || 0;
+        return utils.sanitizeString(value);
+    },
+
+    // 与 SQL_LATEST_STATUS 相同的缺省值规则，用于构造推送给 StatusHub 的最新一行
+    toLatestRow: (machineId, clientId, statusId, statusValues) => {
+        const row = { machine_id: machineId, id: statusId, client_id: clientId };
+        STATUS_COLUMNS.slice(1).forEach((column, i) => {
+            const value = statusValues[i];
+            if (!LATEST_COLUMNS.includes(column)) {
+                row[column] = value ?? null;
+            } else if (LATEST_DEFAULTS[column] !== undefined) {
+                row[column] = value || LATEST_DEFAULTS[column];
+            } else {
+                row[column] = value ?? 0;
+            }
+        });
+        return row;
+    },
+
     handleError: (error, status = 500) => {
         console.error('Error:', error);
         return new Response(
@@ -67,84 +312,110 @@ const utils = {
                 }
             }
         );
-    },
+    }
+};
 
-    async cleanupOldData(env) {
-        try {
-            // 添加时间限制
-            const cutoffTime = Math.floor(Date.now() / 1000) - (7 * 24 * 60 * 60); // 7天
-            
-            // 删除旧数据
-            await env.DB
-                .prepare(`
-                    DELETE FROM status 
-                    WHERE insert_utc_ts < ? 
-                    AND id NOT IN (
-                        SELECT id
-                        FROM (
-                            SELECT id
-                            FROM status
-                            WHERE client_id = status.client_id
-                            ORDER BY insert_utc_ts DESC
-                            LIMIT ?
-                        )
-                    )
-                `)
-                .bind(cutoffTime, DATA_RETENTION.MAX_RECORDS_PER_CLIENT)
-                .run();
+// 基于 Map 插入顺序的 LRU 缓存，容量固定，get/set 均为 O(1)
+class LruCache {
+    constructor(maxEntries) {
+        this.maxEntries = maxEntries;
+        this.entries = new Map();
+    }
 
-            // 删除没有关联状态数据的客户端
-            await env.DB
-                .prepare(`
-                    DELETE FROM client 
-                    WHERE id NOT IN (
-                        SELECT DISTINCT client_id 
-                        FROM status
-                    )
-                `)
-                .run();
+    get(key) {
+        const value = this.entries.get(key);
+        if (value !== undefined) {
+            // 重新插入以标记为最近使用
+            this.entries.delete(key);
+            this.entries.set(key, value);
+        }
+        return value;
+    }
 
-            console.log(`Cleaned up old data, keeping ${DATA_RETENTION.MAX_RECORDS_PER_CLIENT} latest records per client`);
-        } catch (error) {
-            console.error('Error cleaning up old data:', error);
+    set(key, value) {
+        this.entries.delete(key);
+        this.entries.set(key, value);
+        if (this.entries.size > this.maxEntries) {
+            this.entries.delete(this.entries.keys().next().value);
         }
     }
-};
 
-// 速率限制中间件
+    delete(key) {
+        this.entries.delete(key);
+    }
+}
+
+const clientIdCache = new LruCache(CLIENT_CACHE.MAX_ENTRIES);
+
+// 速率限制中间件：滑动窗口计数器，每个 key 只保存两个计数，存放在固定容量的 LRU 中
 class RateLimiter {
-    constructor() {
-        this.requests = new Map();
+    constructor(maxKeys) {
+        this.counters = new LruCache(maxKeys);
     }
 
-    async checkLimit(request) {
-        const ip = request.headers.get('CF-Connecting-IP') || 'unknown';
-        const now = Date.now();
-        const windowStart = now - (RATE_LIMIT.WINDOW_SIZE * 1000);
+    // 用上一窗口的计数按剩余时间比例加权，近似任意时刻往前一个窗口内的请求数，O(1)
+    hit(key, limit, now = Date.now()) {
+        const windowMs = RATE_LIMIT.WINDOW_SIZE * 1000;
+        const windowStart = now - now % windowMs;
+        const counter = this.counters.get(key) || { windowStart, current: 0, previous: 0 };
 
-        // 清理过期的请求记录
-        if (this.requests.has(ip)) {
-            this.requests.get(ip).timestamps = this.requests.get(ip).timestamps.filter(
-                time => time > windowStart
-            );
+        if (counter.windowStart !== windowStart) {
+            counter.previous = windowStart - counter.windowStart === windowMs ? counter.current : 0;
+            counter.current = 0;
+            counter.windowStart = windowStart;
         }
 
-        // 获取或初始化请求记录
-        const record = this.requests.get(ip) || { timestamps: [] };
-        
-        // 检查是否超过限制
-        if (record.timestamps.length >= RATE_LIMIT.MAX_REQUESTS) {
+        const weight = 1 - (now - windowStart) / windowMs;
+        const allowed = counter.previous * weight + counter.current < limit;
+        if (allowed) {
+            counter.current++;
+        }
+        this.counters.set(key, counter);
+        return allowed;
+    }
+
+    // 先在本 isolate 内检查；绑定了 RATE_LIMITER 时再由 Durable Object 做跨 isolate 的确认
+    async consume(env, key, limit) {
+        if (!this.hit(key, limit)) {
             return false;
         }
+        if (!env?.RATE_LIMITER) {
+            return true;
+        }
+        try {
+            const stub = env.RATE_LIMITER.get(env.RATE_LIMITER.idFromName(key));
+            const response = await stub.fetch(`https://rate-limiter/check?limit=${limit}`);
+            return response.status !== 429;
+        } catch (error) {
+            // 限流服务不可用时放行，只依赖本地限制
+            console.error('Error checking rate limiter object:', error);
+            return true;
+        }
+    }
 
-        // 记录新的请求
-        record.timestamps.push(now);
-        this.requests.set(ip, record);
-        return true;
+    // 各项上限可通过同名环境变量覆盖（如压力测试时调高 AGENT_IP_MAX_REQUESTS），无效值使用默认值
+    limitFor(env, name) {
+        const value = parseInt(env?.[name]);
+        return value > 0 ? value : RATE_LIMIT[name];
+    }
+
+    // 匿名访问按 IP 限制
+    async checkLimit(request, env) {
+        return this.consume(env, `ip:${utils.getClientIp(request)}`, this.limitFor(env, 'MAX_REQUESTS'));
+    }
+
+    // 上报接口按来源 IP 设置较高的总上限，在读取请求体之前检查，无效请求同样计数
+    async checkAgentIpLimit(request, env) {
+        return this.consume(env, `agent-ip:${utils.getClientIp(request)}`, this.limitFor(env, 'AGENT_IP_MAX_REQUESTS'));
+    }
+
+    // 上报客户端按 machine_id 限制
+    async checkAgentLimit(env, machineId) {
+        return this.consume(env, `agent:${machineId}`, this.limitFor(env, 'AGENT_MAX_REQUESTS'));
     }
 }
 
-const rateLimiter = new RateLimiter();
+const rateLimiter = new RateLimiter(RATE_LIMIT.MAX_TRACKED_KEYS);
 
 // 修改 getLocationInfo 函数
 async function getLocationInfo(request) {
@@ -180,9 +451,156 @@ async function getLocationInfo(request) {
     }
 }
 
+// 定时维护任务：汇总与数据保留，由 Cron Trigger 调用
+const maintenance = {
+    // 重复执行 DELETE 直到删除行数不足一个分块，每次删除量和总次数都有上限
+    async deleteInChunks(env, sql, ...params) {
+        let total = 0;
+        for (let i = 0; i < DATA_RETENTION.MAX_CHUNKS_PER_RUN; i++) {
+            const { meta } = await env.DB
+                .prepare(sql)
+                .bind(...params, DATA_RETENTION.DELETE_CHUNK_SIZE)
+                .run();
+            total += meta.changes;
+            if (meta.changes < DATA_RETENTION.DELETE_CHUNK_SIZE) break;
+        }
+        return total;
+    },
+
+    async rollup(env, now) {
+        // 1 分钟汇总：从上次汇总的最后一分钟开始（覆盖可能不完整的那一分钟），到当前分钟之前；
+        // 起点取该时刻之后的第一条原始数据，跳过没有上报的空档
+        const minuteEnd = now - now % 60;
+        const last1m = await env.DB.prepare('SELECT MAX(bucket_ts) AS ts FROM status_1m').first('ts');
+        const first = await env.DB
+            .prepare('SELECT MIN(insert_utc_ts) AS ts FROM status WHERE insert_utc_ts >= ?')
+            .bind(last1m || 0)
+            .first('ts');
+        if (first !== null) {
+            const minuteStart = first - first % 60;
+            const rollupEnd = Math.min(minuteEnd, minuteStart + DATA_RETENTION.ROLLUP_MAX_SPAN);
+            if (minuteStart < rollupEnd) {
+                await env.DB.prepare(SQL_ROLLUP_1M).bind(minuteStart, rollupEnd).run();
+            }
+
+            // 1 小时汇总：重新计算最后一个小时，直到已完成的分钟汇总为止
+            const last1h = await env.DB.prepare('SELECT MAX(bucket_ts) AS ts FROM status_1h').first('ts');
+            const hourStart = last1h !== null ? last1h : minuteStart - minuteStart % 3600;
+            if (hourStart < rollupEnd) {
+                await env.DB.prepare(SQL_ROLLUP_1H).bind(hourStart, rollupEnd).run();
+            }
+        }
+
+        // 下次运行会从最后一个 1m/1h 桶开始重新汇总，这两个桶及之后依赖的数据都不能被清理
+        const watermarks = await env.DB.prepare(`
+            SELECT (SELECT MAX(bucket_ts) FROM status_1m) AS raw,
+                   (SELECT MAX(bucket_ts) FROM status_1h) AS minute
+        `).first();
+        return { raw: watermarks?.raw ?? 0, minute: watermarks?.minute ?? 0 };
+    },
+
+    async applyRetention(env, now, watermarks) {
+        // 原始数据按时间索引分块删除，保留每个客户端的最新一条（latest_status 引用），
+        // 且不删除下次汇总仍会读取的数据：分块删除可能停在某一分钟中间，
+        // 若删到最后一个 1m 桶内，下次重新汇总该分钟时只能看到部分样本
+        const rawDeleted = await maintenance.deleteInChunks(env, `
+            DELETE FROM status WHERE id IN (
+                SELECT id FROM status
+                WHERE insert_utc_ts < ?
+                AND id NOT IN (SELECT status_id FROM latest_status)
+                ORDER BY insert_utc_ts
+                LIMIT ?
+            )
+        `, Math.min(now - DATA_RETENTION.RAW_SECONDS, watermarks.raw));
+
+        const rollupDeleted = await maintenance.deleteInChunks(env, `
+            DELETE FROM status_1m WHERE rowid IN (
+                SELECT rowid FROM status_1m WHERE bucket_ts < ? ORDER BY bucket_ts LIMIT ?
+            )
+        `, Math.min(now - DATA_RETENTION.ROLLUP_1M_SECONDS, watermarks.minute)) + await maintenance.deleteInChunks(env, `
+            DELETE FROM status_1h WHERE rowid IN (
+                SELECT rowid FROM status_1h WHERE bucket_ts < ? ORDER BY bucket_ts LIMIT ?
+            )
+        `, now - DATA_RETENTION.ROLLUP_1H_SECONDS);
+
+        // 长期离线的客户端连同其所有数据一起删除
+        const { results: expired } = await env.DB
+            .prepare(`
+                SELECT l.client_id, c.machine_id FROM latest_status l
+                JOIN client c ON c.id = l.client_id
+                WHERE l.insert_utc_ts < ? LIMIT 100
+            `)
+            .bind(now - DATA_RETENTION.CLIENT_EXPIRE_SECONDS)
+            .run();
+        if (expired && expired.length > 0) {
+            const ids = expired.map(row => row.client_id);
+            const placeholders = ids.map(() => '?').join(', ');
+            await env.DB.batch(
+                ['latest_status', 'status', 'status_1m', 'status_1h'].map(table =>
+                    env.DB.prepare(`DELETE FROM ${table} WHERE client_id IN (${placeholders})`).bind(...ids)
+                ).concat(env.DB.prepare(`DELETE FROM client WHERE id IN (${placeholders})`).bind(...ids))
+            );
+
+            // 推送中心的快照只随上报增量维护，需要显式通知它移除这些客户端
+            const machineIds = expired.map(row => row.machine_id);
+            machineIds.forEach(machineId => clientIdCache.delete(machineId));
+            if (env.STATUS_HUB) {
+                await routeHandlers.notifyStatusHub(env, '/remove', machineIds);
+            }
+        }
+
+        console.log(`Retention: deleted ${rawDeleted} raw rows, ${rollupDeleted} rollup rows, ${expired?.length || 0} expired clients`);
+    },
+
+    async run(env) {
+        if (!env.DB) {
+            console.error('Database binding not found');
+            return;
+        }
+        const now = Math.floor(Date.now() / 1000);
+        try {
+            const watermarks = await maintenance.rollup(env, now);
+            await maintenance.applyRetention(env, now, watermarks);
+        } catch (error) {
+            console.error('Error in scheduled maintenance:', error);
+        }
+    }
+};
+
 // 路由处理函数
 const routeHandlers = {
-    async handlePostStatus(request, env) {
+    async ingestStatus(env, machineId, name, statusValues) {
+        const cached = clientIdCache.get(machineId);
+        const statements = [];
+
+        // 名称未变化且 client_id 已缓存时，只需插入 status
+        if (!cached || cached.name !== name) {
+            statements.push(env.DB.prepare(SQL_UPSERT_CLIENT).bind(machineId, name));
+        }
+        statements.push(cached
+            ? env.DB.prepare(SQL_INSERT_STATUS_BY_ID).bind(cached.id, ...statusValues)
+            : env.DB.prepare(SQL_INSERT_STATUS_BY_MACHINE_ID).bind(machineId, ...statusValues));
+
+        const results = await env.DB.batch(statements);
+        const clientId = cached ? cached.id : results[0].results[0].id;
+        const statusId = results[results.length - 1].results[0].id;
+        clientIdCache.set(machineId, { id: clientId, name });
+        return { clientId, statusId };
+    },
+
+    async notifyStatusHub(env, path, data) {
+        try {
+            const hub = env.STATUS_HUB.get(env.STATUS_HUB.idFromName('global'));
+            await hub.fetch(`https://status-hub${path}`, {
+                method: 'POST',
+                body: JSON.stringify(data)
+            });
+        } catch (error) {
+            console.error('Error notifying status hub:', error);
+        }
+    },
+
+    async handlePostStatus(request, env, ctx) {
         try {
             // 检查 env.DB 是否存在
             if (!env.DB) {
@@ -190,12 +608,12 @@ const routeHandlers = {
                 return utils.handleError(new Error('数据库未配置'), 500);
             }
 
-            // 速率限制检查
-            if (!await rateLimiter.checkLimit(request)) {
+            // 先按来源 IP 限流，被拒绝的请求不再解析请求体
+            if (!await rateLimiter.checkAgentIpLimit(request, env)) {
                 return utils.handleError(new Error(ERROR_MESSAGES.RATE_LIMIT), 429);
             }
 
-            const formData = await request.formData();
+            const formData = await utils.parseStatusBody(request);
             
             // 数据验证
             if (!utils.validateMetrics(formData)) {
@@ -204,6 +622,12 @@ const routeHandlers = {
 
             // 清理和验证数据
             const machineId = utils.sanitizeString(formData.get('machine_id'));
+
+            // 单个客户端的额度在解析出 machine_id 后检查
+            if (!await rateLimiter.checkAgentLimit(env, machineId)) {
+                return utils.handleError(new Error(ERROR_MESSAGES.RATE_LIMIT), 429);
+            }
+
             const name = utils.sanitizeString(formData.get('name')) || '未命名';
             const system = utils.sanitizeString(formData.get('system')) || '';
             const location = utils.sanitizeString(formData.get('location')) || '未知';
@@ -216,65 +640,34 @@ const routeHandlers = {
             console.log('Location info:', locationInfo);
             console.log('Inserting status with country_code:', locationInfo?.country_code);
 
-            // 数据库操作
-            let clientId;
-            let { results } = await env.DB
-                .prepare('SELECT id FROM client WHERE machine_id = ?')
-                .bind(machineId)
-                .run();
+            // 数据库操作：client UPSERT 与 status 插入合并为一次 batch 往返
+            const statusValues = [
+                name,
+                system,
+                location,
+                Math.floor(Date.now() / 1000),
+                ...STATUS_FIELDS.map(([field, type]) => utils.parseField(formData.get(field), type)),
+                ipAddress,
+                locationInfo?.country_code || 'xx'
+            ];
 
-            if (results && results[0]) {
-                clientId = results[0].id;
-                await env.DB
-                    .prepare('UPDATE client SET name = ? WHERE id = ?')
-                    .bind(name, clientId)
-                    .run();
-            } else {
-                const { meta } = await env.DB
-                    .prepare('INSERT INTO client (machine_id, name) VALUES (?, ?)')
-                    .bind(machineId, name)
-                    .run();
-                clientId = meta.last_row_id;
+            let ingested;
+            try {
+                ingested = await routeHandlers.ingestStatus(env, machineId, name, statusValues);
+            } catch (error) {
+                // 缓存的 client_id 可能已被清理，丢弃缓存后按 machine_id 重试一次
+                if (!clientIdCache.get(machineId)) throw error;
+                clientIdCache.delete(machineId);
+                ingested = await routeHandlers.ingestStatus(env, machineId, name, statusValues);
             }
+            const { clientId, statusId } = ingested;
 
-            // 插入状态数据
-            await env.DB
-                .prepare(`
-                    INSERT INTO status (
-                        client_id, name, system, location, insert_utc_ts,
-                        uptime, cpu_percent, net_tx, net_rx, disks_total_kb,
-                        disks_avail_kb, cpu_num_cores, mem_total, mem_free,
-                        mem_used, swap_total, swap_free, process_count,
-                        connection_count, ip_address, country_code
-                    ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
-                `)
-                .bind(
-                    clientId,
-                    name,
-                    system,
-                    location,
-                    Math.floor(Date.now() / 1000),
-                    parseInt(formData.get('uptime')) || 0,
-                    parseFloat(formData.get('cpu_percent')) || 0,
-                    parseInt(formData.get('net_tx')) || 0,
-                    parseInt(formData.get('net_rx')) || 0,
-                    parseInt(formData.get('disks_total_kb')) || 0,
-                    parseInt(formData.get('disks_avail_kb')) || 0,
-                    parseInt(formData.get('cpu_num_cores')) || 0,
-                    parseFloat(formData.get('mem_total')) || 0,
-                    parseFloat(formData.get('mem_free')) || 0,
-                    parseFloat(formData.get('mem_used')) || 0,
-                    parseFloat(formData.get('swap_total')) || 0,
-                    parseFloat(formData.get('swap_free')) || 0,
-                    parseInt(formData.get('process_count')) || 0,
-                    parseInt(formData.get('connection_count')) || 0,
-                    ipAddress,
-                    locationInfo?.country_code || 'xx'
-                )
-                .run();
-
-            // 每次插入数据后都执行清理
-            await utils.cleanupOldData(env);
+            // 通知推送中心，不占用上报请求的响应时间
+            if (env.STATUS_HUB) {
+                ctx.waitUntil(routeHandlers.notifyStatusHub(
+                    env, '/notify', utils.toLatestRow(machineId, clientId, statusId, statusValues)
+                ));
+            }
 
             return new Response(
                 JSON.stringify(utils.formatResponse(true, {
@@ -302,58 +695,88 @@ const routeHandlers = {
                 return utils.handleError(new Error('数据库未配置'), 500);
             }
 
-            if (!await rateLimiter.checkLimit(request)) {
+            if (!await rateLimiter.checkLimit(request, env)) {
                 return utils.handleError(new Error(ERROR_MESSAGES.RATE_LIMIT), 429);
             }
 
-            const { results } = await env.DB
-                .prepare(`
-                    SELECT 
-                        c.machine_id,
-                        s.*
-                    FROM status s
-                    JOIN client c ON s.client_id = c.id
-                    WHERE s.id IN (
-                        SELECT MAX(id)
-                        FROM status
-                        GROUP BY client_id
-                    )
-                    ORDER BY s.insert_utc_ts DESC
-                `)
-                .run();
+            // latest_status 每个客户端只有一行，先取其版本号判断数据是否变化
+            const version = await env.DB.prepare(SQL_LATEST_VERSION).first();
+            const etag = `"${version?.client_count || 0}-${version?.max_status_id || 0}-${version?.max_ts || 0}"`;
+
+            const headers = {
+                'Content-Type': 'application/json',
+                'Access-Control-Allow-Origin': '*',
+                'Cache-Control': 'no-cache',
+                'ETag': etag
+            };
 
-            // 在 handleGetLatestStatus 中添加日志
-            console.log('Retrieved results:', results);
-
-            // 处理结果，计算负载值并确保所有字段存在
-            const processedResults = (results || []).map(server => {
-                return {
-                    ...server,
-                    // 确保所有必要字段存在且有合理的默认值
-                    name: server.name || '未命名',
-                    location: server.location || '未知',
-                    system: server.system || 'Unknown',
-                    uptime: parseInt(server.uptime) || 0,
-                    cpu_percent: parseFloat(server.cpu_percent) || 0,
-                    net_tx: parseInt(server.net_tx) || 0,
-                    net_rx: parseInt(server.net_rx) || 0,
-                    disks_total_kb: parseInt(server.disks_total_kb) || 0,
-                    disks_avail_kb: parseInt(server.disks_avail_kb) || 0,
-                    cpu_num_cores: parseInt(server.cpu_num_cores) || 1,
-                    mem_total: parseFloat(server.mem_total) || 0,
-                    mem_free: parseFloat(server.mem_free) || 0,
-                    mem_used: parseFloat(server.mem_used) || 0,
-                    swap_total: parseFloat(server.swap_total) || 0,
-                    swap_free: parseFloat(server.swap_free) || 0,
-                    process_count: parseInt(server.process_count) || 0,
-                    connection_count: parseInt(server.connection_count) || 0,
-                    country_code: server.country_code || 'xx',
-                    cpu_model: server.cpu_model || 'Unknown CPU'
+            if (request.headers.get('If-None-Match') === etag) {
+                return new Response(null, { status: 304, headers });
+            }
+
+            if (latestStatusSnapshot.etag !== etag) {
+                const { results } = await env.DB.prepare(SQL_LATEST_STATUS).run();
+                latestStatusSnapshot = {
+                    etag,
+                    body: JSON.stringify(utils.formatResponse(true, results || []))
                 };
-            });
+            }
+
+            return new Response(latestStatusSnapshot.body, { headers });
+        } catch (error) {
+            console.error('Error in handleGetLatestStatus:', error);
+            return utils.handleError(error);
+        }
+    },
+
+    async handleGetStatusHistory(request, env) {
+        try {
+            if (!env.DB) {
+                console.error('Database binding not found');
+                return utils.handleError(new Error('数据库未配置'), 500);
+            }
+
+            if (!await rateLimiter.checkLimit(request, env)) {
+                return utils.handleError(new Error(ERROR_MESSAGES.RATE_LIMIT), 429);
+            }
+
+            const params = new URL(request.url).searchParams;
+            const now = Math.floor(Date.now() / 1000);
+            const machineId = params.get('machine_id');
+            const metric = params.get('metric');
+            // 时间范围限制在最长保留期内：to 不晚于当前时间，from 不早于 1 小时汇总的保留起点
+            const to = Math.min(parseInt(params.get('to')) || now, now);
+            const from = Math.max(parseInt(params.get('from')) || to - HISTORY.DEFAULT_RANGE, to - DATA_RETENTION.ROLLUP_1H_SECONDS);
+            const rollupMetric = ROLLUP_METRICS.find(([name]) => name === metric);
+
+            if (!machineId || !rollupMetric || !(from < to)) {
+                return utils.handleError(new Error(ERROR_MESSAGES.INVALID_DATA), 400);
+            }
+
+            // 点数有上限：起点按 step 对齐后最多多出一个桶，因此 step 至少为 range / (MAX_POINTS - 1)
+            const range = to - from;
+            let step = Math.min(
+                Math.max(parseInt(params.get('step')) || 0, Math.ceil(range / (HISTORY.MAX_POINTS - 1)), 1),
+                range
+            );
+
+            // 选择仍保留 from 时刻数据、且 step 小于下一级分辨率的数据源；step 向上取整为其分辨率的整数倍
+            const source = HISTORY_SOURCES.find((candidate, i) => {
+                const coarser = HISTORY_SOURCES[i + 1];
+                return (!coarser || step < coarser.resolution) && from >= now - candidate.retention;
+            }) || HISTORY_SOURCES[HISTORY_SOURCES.length - 1];
+            step = Math.ceil(step / source.resolution) * source.resolution;
+
+            // D1 一次返回完整结果集，内存占用由 MAX_POINTS 限制
+            const { results } = await env.DB
+                .prepare(source.sql(rollupMetric[1], metric))
+                .bind(step, machineId, from - from % step, to)
+                .run();
 
             return new Response(
-                JSON.stringify(utils.formatResponse(true, processedResults)),
+                JSON.stringify(utils.formatResponse(true, {
+                    machine_id: machineId, metric, source: source.name, step, from, to, points: results || []
+                })),
                 {
                     headers: {
                         'Content-Type': 'application/json',
@@ -363,7 +786,25 @@ const routeHandlers = {
                 }
             );
         } catch (error) {
-            console.error('Error in handleGetLatestStatus:', error);
+            console.error('Error in handleGetStatusHistory:', error);
+            return utils.handleError(error);
+        }
+    },
+
+    async handleGetStatusStream(request, env) {
+        try {
+            if (!env.STATUS_HUB) {
+                return utils.handleError(new Error('推送服务未配置'), 501);
+            }
+
+            if (!await rateLimiter.checkLimit(request, env)) {
+                return utils.handleError(new Error(ERROR_MESSAGES.RATE_LIMIT), 429);
+            }
+
+            const hub = env.STATUS_HUB.get(env.STATUS_HUB.idFromName('global'));
+            return await hub.fetch('https://status-hub/stream');
+        } catch (error) {
+            console.error('Error in handleGetStatusStream:', error);
             return utils.handleError(error);
         }
     },
@@ -452,7 +893,7 @@ const routeHandlers = {
 
 // 主导出
 export default {
-    async fetch(request, env) {
+    async fetch(request, env, ctx) {
         try {
             // 添加调试日志
             console.log('Request URL:', request.url);
@@ -472,6 +913,8 @@ export default {
             const routes = {
                 'POST /status': routeHandlers.handlePostStatus,
                 'GET /status/latest': routeHandlers.handleGetLatestStatus,
+                'GET /status/stream': routeHandlers.handleGetStatusStream,
+                'GET /status/history': routeHandlers.handleGetStatusHistory,
                 'GET /': routeHandlers.handleGetIndex,
                 'GET /status': routeHandlers.handleGetStatus,
             };
@@ -481,7 +924,7 @@ export default {
             const handler = routes[routeKey];
 
             if (handler) {
-                return await handler(request, env);
+                return await handler(request, env, ctx);
             }
 
             console.error('Route not found:', routeKey);
@@ -490,6 +933,185 @@ export default {
             console.error('Error in fetch:', error);
             return utils.handleError(error);
         }
+    },
+
+    // Cron Trigger 入口：汇总与数据保留
+    async scheduled(event, env, ctx) {
+        ctx.waitUntil(maintenance.run(env));
     }
 };
 
+// 状态推送中心（Durable Object）：接收上报通知，向所有 SSE 连接推送发生变化的客户端和字段
+export class StatusHub {
+    constructor(state, env) {
+        this.state = state;
+        this.env = env;
+        this.servers = new Map();   // machine_id -> 最新一行
+        this.loaded = false;
+        this.loading = null;
+        this.streams = new Set();
+        this.pending = new Map();   // machine_id -> 尚未推送的变化字段
+        this.flushTimer = null;
+        this.heartbeatTimer = null;
+        this.encoder = new TextEncoder();
+    }
+
+    async fetch(request) {
+        const url = new URL(request.url);
+        if (url.pathname === '/notify') {
+            return this.handleNotify(await request.json());
+        }
+        if (url.pathname === '/remove') {
+            return this.handleRemove(await request.json());
+        }
+        if (url.pathname === '/stream') {
+            return this.handleStream();
+        }
+        return new Response('Not found', { status: 404 });
+    }
+
+    // 首个连接建立时从 D1 加载一次快照，之后依赖上报和清理通知增量维护
+    loadSnapshot() {
+        if (!this.loading) {
+            this.loading = this.env.DB.prepare(SQL_LATEST_STATUS).run()
+                .then(({ results }) => {
+                    for (const row of results || []) {
+                        this.servers.set(row.machine_id, row);
+                    }
+                    this.loaded = true;
+                })
+                .catch(error => {
+                    this.loading = null;
+                    throw error;
+                });
+        }
+        return this.loading;
+    }
+
+    async handleStream() {
+        await this.loadSnapshot();
+
+        const { readable, writable } = new TransformStream();
+        const writer = writable.getWriter();
+        this.streams.add(writer);
+        this.write(writer, `retry: ${STATUS_STREAM.RETRY_MS}\n\n`);
+        this.write(writer, this.formatEvent('snapshot', [...this.servers.values()]));
+
+        if (!this.heartbeatTimer) {
+            this.heartbeatTimer = setInterval(() => this.heartbeat(), STATUS_STREAM.HEARTBEAT_MS);
+        }
+
+        return new Response(readable, {
+            headers: {
+                'Content-Type': 'text/event-stream',
+                'Cache-Control': 'no-cache',
+                'Access-Control-Allow-Origin': '*'
+            }
+        });
+    }
+
+    // 快照尚未加载时没有订阅者，通知可以忽略；加载中则等待，避免丢失变化
+    async waitForSnapshot() {
+        if (this.loading) {
+            await this.loading.catch(() => {});
+        }
+        return this.loaded;
+    }
+
+    async handleNotify(row) {
+        if (!await this.waitForSnapshot()) {
+            return new Response(null, { status: 204 });
+        }
+
+        const previous = this.servers.get(row.machine_id);
+        const changes = {};
+        for (const [key, value] of Object.entries(row)) {
+            if (!previous || previous[key] !== value) {
+                changes[key] = value;
+            }
+        }
+        this.servers.set(row.machine_id, previous ? { ...previous, ...row } : row);
+
+        if (this.streams.size > 0 && Object.keys(changes).length > 0) {
+            this.pending.set(row.machine_id, { ...this.pending.get(row.machine_id), ...changes });
+            this.scheduleFlush();
+        }
+        return new Response(null, { status: 204 });
+    }
+
+    // 定时任务删除长期离线的客户端后调用，pending 中以 null 表示移除
+    async handleRemove(machineIds) {
+        if (!await this.waitForSnapshot()) {
+            return new Response(null, { status: 204 });
+        }
+
+        for (const machineId of machineIds) {
+            if (!this.servers.delete(machineId)) continue;
+            if (this.streams.size > 0) {
+                this.pending.set(machineId, null);
+                this.scheduleFlush();
+            } else {
+                this.pending.delete(machineId);
+            }
+        }
+        return new Response(null, { status: 204 });
+    }
+
+    scheduleFlush() {
+        if (!this.flushTimer) {
+            this.flushTimer = setTimeout(() => this.flush(), STATUS_STREAM.FLUSH_INTERVAL_MS);
+        }
+    }
+
+    flush() {
+        this.flushTimer = null;
+        if (this.pending.size === 0) return;
+
+        const patches = [...this.pending].map(([machine_id, changes]) =>
+            changes === null ? { machine_id, removed: true } : { machine_id, changes });
+        this.pending.clear();
+        this.broadcast(this.formatEvent('patch', patches));
+    }
+
+    heartbeat() {
+        if (this.streams.size === 0) {
+            clearInterval(this.heartbeatTimer);
+            this.heartbeatTimer = null;
+            return;
+        }
+        this.broadcast(': ping\n\n');
+    }
+
+    formatEvent(event, data) {
+        return `event: ${event}\ndata: ${JSON.stringify(data)}\n\n`;
+    }
+
+    // 每个事件只编码一次，再写入所有连接
+    broadcast(text) {
+        const chunk = this.encoder.encode(text);
+        for (const writer of this.streams) {
+            this.write(writer, chunk);
+        }
+    }
+
+    write(writer, data) {
+        const chunk = typeof data === 'string' ? this.encoder.encode(data) : data;
+        writer.write(chunk).catch(() => {
+            // 连接已断开
+            this.streams.delete(writer);
+        });
+    }
+}
+
+// 跨 isolate 的速率限制（Durable Object，可选）：每个 key 对应一个实例，只保存一个滑动窗口计数器
+export class RateLimiterObject {
+    constructor(state, env) {
+        this.state = state;
+        this.limiter = new RateLimiter(1);
+    }
+
+    async fetch(request) {
+        const limit = parseInt(new URL(request.url).searchParams.get('limit')) || RATE_LIMIT.MAX_REQUESTS;
+        return new Response(null, { status: this.limiter.hit('self', limit) ? 204 : 429 });
+    }
+}
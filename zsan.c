@@ -15,6 +15,8 @@
 #include <errno.h>
 #include <ifaddrs.h>
 #include <arpa/inet.h>
+#include <stddef.h>
+#include <math.h>
 
 // 添加函数声明
 void log_message(const char *level, const char *format, ...);
@@ -43,22 +45,61 @@ typedef struct {
     char cpu_model[256];            // CPU 型号
     unsigned long total_tx;          // 总上传流量
     unsigned long total_rx;          // 总下载流量
+    double mem_available;          // 可用内存（MemAvailable）
+    double mem_dirty;              // 脏页
+    double mem_writeback;          // 正在回写的页
+    double mem_slab;               // 内核 Slab
+    double mem_shmem;              // 共享内存（含 tmpfs）
+    unsigned long hugepages_total; // 大页总数
+    unsigned long hugepages_free;  // 空闲大页数
+    double pgfault_rate;           // 缺页速率（次/秒）
+    double pgmajfault_rate;        // 主缺页速率（次/秒）
+    double pswpin_rate;            // 换入速率（页/秒）
+    double pswpout_rate;           // 换出速率（页/秒）
+    unsigned long oom_kill;        // OOM kill 累计次数
+    char numa_mem[256];            // 各 NUMA 节点内存，格式 "节点:总量:已用,..."（MiB），放不下时以 ",+" 结尾
+    double tcp_retrans_rate;       // TCP 重传段速率（段/秒）
+    double tcp_retrans_pct;        // 重传段占发送段的百分比
+    double tcp_out_rst_rate;       // 发出 RST 的速率（次/秒）
+    double tcp_estab_reset_rate;   // 已建立连接被重置的速率（次/秒）
+    double listen_overflow_rate;   // accept 队列溢出速率（次/秒）
+    double listen_drop_rate;       // 监听端口丢弃 SYN 的速率（次/秒）
+    double udp_rcvbuf_err_rate;    // UDP 接收缓冲区溢出速率（次/秒）
+    double syncookie_sent_rate;    // 发出 SYN cookie 的速率（次/秒）
+    double syncookie_recv_rate;    // 收到有效 SYN cookie 的速率（次/秒）
 } SystemInfo;
 
+// 可复用的输出缓冲区：容量只增不减，采集循环中复用同一块内存
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;                    // 扩容失败后置位，后续追加全部忽略
+} Buffer;
+
+// 上报数据的编码方式
+typedef struct {
+    const char *name;              // -f 参数取值
+    const char *content_type;      // 发送时使用的 Content-Type
+    void (*encode)(Buffer *buf, const SystemInfo *info);
+} PayloadEncoder;
+
 // 全局变量声明
 char g_server_name[64] = "未命名";
 char g_server_location[64] = "未知";
 
 // 函数声明 - 确保返回类型与定义匹配
 int get_connection_count(void);
-char *metrics_to_post_data(const SystemInfo *info);
-int send_post_request(const char *url, const char *data);
+const PayloadEncoder *find_encoder(const char *name);
+int serialize_metrics(const SystemInfo *info, const PayloadEncoder *encoder, Buffer *buf);
+int send_post_request(const char *url, const char *data, size_t len, const char *content_type);
 void get_system_info(char *buffer, size_t size);
 int get_machine_id(char *buffer, size_t buffer_size);  // 修改为返回 int
 void get_total_traffic(unsigned long *net_tx, unsigned long *net_rx, 
                       unsigned long *total_tx, unsigned long *total_rx);
 void get_disk_usage(unsigned long *disks_total_kb, unsigned long *disks_avail_kb);
-void get_swap_info(double *swap_total, double *swap_free);
+void get_memory_stats(SystemInfo *info);
+void get_net_proto_stats(SystemInfo *info);
 int get_process_count(void);
 void collect_metrics(SystemInfo *info);
 
@@ -147,26 +188,148 @@ void read_cpu_info(ProcResult *result) {
     result->cpu_st = steal;
 }
 
+// /proc/meminfo 中关心的字段（单位 kB，大页字段为个数）
+typedef struct {
+    unsigned long long mem_total;
+    unsigned long long mem_free;
+    unsigned long long mem_available;
+    unsigned long long buffers;
+    unsigned long long cached;
+    unsigned long long swap_total;
+    unsigned long long swap_free;
+    unsigned long long dirty;
+    unsigned long long writeback;
+    unsigned long long slab;
+    unsigned long long shmem;
+    unsigned long long hugepages_total;
+    unsigned long long hugepages_free;
+    unsigned long long file_pages;
+} MemInfoRaw;
+
+// /proc/vmstat 中关心的计数器（自启动以来的累计值）
+typedef struct {
+    unsigned long long pgfault;
+    unsigned long long pgmajfault;
+    unsigned long long pswpin;
+    unsigned long long pswpout;
+    unsigned long long oom_kill;
+} VmStatRaw;
+
+// 字段名到结构体偏移的映射，解析时每行只查一次表
+typedef struct {
+    const char *key;
+    size_t offset;
+} StatField;
+
+static const StatField MEMINFO_FIELDS[] = {
+    {"MemTotal", offsetof(MemInfoRaw, mem_total)},
+    {"MemFree", offsetof(MemInfoRaw, mem_free)},
+    {"MemAvailable", offsetof(MemInfoRaw, mem_available)},
+    {"Buffers", offsetof(MemInfoRaw, buffers)},
+    {"Cached", offsetof(MemInfoRaw, cached)},
+    {"SwapTotal", offsetof(MemInfoRaw, swap_total)},
+    {"SwapFree", offsetof(MemInfoRaw, swap_free)},
+    {"Dirty", offsetof(MemInfoRaw, dirty)},
+    {"Writeback", offsetof(MemInfoRaw, writeback)},
+    {"Slab", offsetof(MemInfoRaw, slab)},
+    {"Shmem", offsetof(MemInfoRaw, shmem)},
+    {"HugePages_Total", offsetof(MemInfoRaw, hugepages_total)},
+    {"HugePages_Free", offsetof(MemInfoRaw, hugepages_free)},
+    {"FilePages", offsetof(MemInfoRaw, file_pages)},
+    {NULL, 0}
+};
+
+static const StatField VMSTAT_FIELDS[] = {
+    {"pgfault", offsetof(VmStatRaw, pgfault)},
+    {"pgmajfault", offsetof(VmStatRaw, pgmajfault)},
+    {"pswpin", offsetof(VmStatRaw, pswpin)},
+    {"pswpout", offsetof(VmStatRaw, pswpout)},
+    {"oom_kill", offsetof(VmStatRaw, oom_kill)},
+    {NULL, 0}
+};
+
+#define MAX_NUMA_NODES 1024        // 与内核 CONFIG_NODES_SHIFT 的上限一致
+
+// 一次性读取整个 proc/sysfs 文件到缓冲区，返回读取的字节数，失败返回 -1
+static ssize_t read_file_to_buffer(const char *path, char *buffer, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    size_t total = 0;
+    while (total < size - 1) {
+        ssize_t n = read(fd, buffer + total, size - 1 - total);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        total += n;
+    }
+    close(fd);
+    buffer[total] = '\0';
+    return total;
+}
+
+// 单次遍历解析 "键 值" 或 "键: 值 kB" 形式的统计文件，
+// 兼容 NUMA 节点 meminfo 的 "Node N 键: 值 kB" 前缀
+static void parse_stat_buffer(char *buffer, const StatField *fields, void *out) {
+    char *line = buffer;
+    while (line && *line) {
+        char *next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+
+        if (strncmp(line, "Node ", 5) == 0) {
+            line = strchr(line + 5, ' ');
+            if (!line) break;
+            line++;
+        }
+
+        size_t key_len = strcspn(line, ": ");
+        for (const StatField *f = fields; f->key; f++) {
+            if (strlen(f->key) == key_len && strncmp(line, f->key, key_len) == 0) {
+                *(unsigned long long *)((char *)out + f->offset) = strtoull(line + key_len + 1, NULL, 10);
+                break;
+            }
+        }
+        line = next;
+    }
+}
+
+static int read_meminfo(const char *path, MemInfoRaw *raw) {
+    char buffer[8192];
+    memset(raw, 0, sizeof(*raw));
+    if (read_file_to_buffer(path, buffer, sizeof(buffer)) < 0) return -1;
+    parse_stat_buffer(buffer, MEMINFO_FIELDS, raw);
+    return 0;
+}
+
+static int read_vmstat(VmStatRaw *raw) {
+    char buffer[16384];
+    memset(raw, 0, sizeof(*raw));
+    if (read_file_to_buffer("/proc/vmstat", buffer, sizeof(buffer)) < 0) return -1;
+    parse_stat_buffer(buffer, VMSTAT_FIELDS, raw);
+    return 0;
+}
+
+// 可用内存优先取 MemAvailable，旧内核没有该字段时退化为 Free + Buffers + Cached
+static unsigned long long meminfo_available_kb(const MemInfoRaw *raw) {
+    if (raw->mem_available > 0) return raw->mem_available;
+    return raw->mem_free + raw->buffers + raw->cached;
+}
+
+// 已用内存统一按 MemTotal - 可用内存 计算
+static unsigned long long meminfo_used_kb(const MemInfoRaw *raw) {
+    unsigned long long available = meminfo_available_kb(raw);
+    return raw->mem_total > available ? raw->mem_total - available : 0;
+}
+
 // 从 /proc/meminfo 读取内存信息
 void read_mem_info(ProcResult *result) {
-    FILE *fp = fopen("/proc/meminfo", "r");
-    if (!fp) {
+    MemInfoRaw raw;
+    if (read_meminfo("/proc/meminfo", &raw) != 0) {
         perror("Failed to open /proc/meminfo");
         exit(EXIT_FAILURE);
     }
-    char line[256];
-    unsigned long long mem_total = 0, mem_free = 0, mem_buffers = 0, mem_cached = 0;
-    while (fgets(line, sizeof(line), fp)) {
-        if (sscanf(line, "MemTotal: %llu kB", &mem_total) == 1) continue;
-        if (sscanf(line, "MemFree: %llu kB", &mem_free) == 1) continue;
-        if (sscanf(line, "Buffers: %llu kB", &mem_buffers) == 1) continue;
-        if (sscanf(line, "Cached: %llu kB", &mem_cached) == 1) continue;
-    }
-    fclose(fp);
-    result->mem_total = mem_total / 1024.0; // 转换为 MiB
-    result->mem_free = mem_free / 1024.0;
-    result->mem_used = (mem_total - mem_free) / 1024.0;
-    result->mem_buff_cache = (mem_buffers + mem_cached) / 1024.0;
+    result->mem_total = raw.mem_total / 1024.0; // 转换为 MiB
+    result->mem_free = raw.mem_free / 1024.0;
+    result->mem_used = meminfo_used_kb(&raw) / 1024.0;
+    result->mem_buff_cache = (raw.buffers + raw.cached) / 1024.0;
 }
 
 // 从 /proc/net/tcp 和 /proc/net/udp 读取 TCP/UDP 连接数
@@ -391,25 +554,105 @@ void get_system_info(char *buffer, size_t size) {
     }
 }
 
-// 获取交换分区信息
-void get_swap_info(double *swap_total, double *swap_free) {
-    FILE *fp = fopen("/proc/meminfo", "r");
-    if (!fp) {
-        *swap_total = 0;
-        *swap_free = 0;
-        return;
+static int compare_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// 获取各 NUMA 节点的内存，格式 "节点:总量:已用,..."（MiB），按节点号排序；
+// 缓冲区放不下全部节点时以 ",+" 结尾表示已截断，没有 NUMA 信息时为空字符串
+static void get_numa_memory(char *buffer, size_t size) {
+    static int node_ids[MAX_NUMA_NODES];
+    const char truncated[] = ",+";
+
+    buffer[0] = '\0';
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (!dir) return;
+
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) && count < MAX_NUMA_NODES) {
+        char *endptr;
+        if (strncmp(entry->d_name, "node", 4) != 0) continue;
+        long node = strtol(entry->d_name + 4, &endptr, 10);
+        if (endptr == entry->d_name + 4 || *endptr != '\0') continue;
+        node_ids[count++] = (int)node;
     }
-    
-    char line[256];
-    unsigned long long total = 0, free = 0;
-    while (fgets(line, sizeof(line), fp)) {
-        if (sscanf(line, "SwapTotal: %llu kB", &total) == 1) continue;
-        if (sscanf(line, "SwapFree: %llu kB", &free) == 1) continue;
+    closedir(dir);
+    qsort(node_ids, count, sizeof(int), compare_int);
+
+    size_t used = 0;
+    int emitted = 0;
+    for (int i = 0; i < count; i++) {
+        char path[64];
+        MemInfoRaw raw;
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/meminfo", node_ids[i]);
+        if (read_meminfo(path, &raw) != 0) continue;
+
+        // 节点 meminfo 没有 MemAvailable，按 MemFree + FilePages 近似可用内存
+        unsigned long long node_avail = raw.mem_free + raw.file_pages;
+        unsigned long long node_used = raw.mem_total > node_avail ? raw.mem_total - node_avail : 0;
+        char item[64];
+        int n = snprintf(item, sizeof(item), "%s%d:%.1f:%.1f",
+                         emitted > 0 ? "," : "", node_ids[i], raw.mem_total / 1024.0, node_used / 1024.0);
+        if (n < 0) continue;
+
+        // 最后一个节点之外都要为截断标记预留空间
+        size_t reserve = i + 1 < count ? sizeof(truncated) - 1 : 0;
+        if (used + n + reserve >= size) {
+            if (used + sizeof(truncated) <= size) {
+                memcpy(buffer + used, truncated, sizeof(truncated));
+            }
+            return;
+        }
+        memcpy(buffer + used, item, n + 1);
+        used += n;
+        emitted++;
     }
-    fclose(fp);
-    
-    *swap_total = total / 1024.0; // 转换为 MiB
-    *swap_free = free / 1024.0;
+}
+
+// 获取内存与内核 VM 统计：单次解析 /proc/meminfo 和 /proc/vmstat，速率按两次采集的差值计算
+void get_memory_stats(SystemInfo *info) {
+    static VmStatRaw last_vm;
+    static struct timespec last_time;
+    static int has_last = 0;
+
+    MemInfoRaw mem;
+    if (read_meminfo("/proc/meminfo", &mem) == 0) {
+        info->mem_total = mem.mem_total / 1024.0;  // 转换为 MiB
+        info->mem_free = mem.mem_free / 1024.0;
+        info->mem_used = meminfo_used_kb(&mem) / 1024.0;
+        info->mem_available = meminfo_available_kb(&mem) / 1024.0;
+        info->swap_total = mem.swap_total / 1024.0;
+        info->swap_free = mem.swap_free / 1024.0;
+        info->mem_dirty = mem.dirty / 1024.0;
+        info->mem_writeback = mem.writeback / 1024.0;
+        info->mem_slab = mem.slab / 1024.0;
+        info->mem_shmem = mem.shmem / 1024.0;
+        info->hugepages_total = mem.hugepages_total;
+        info->hugepages_free = mem.hugepages_free;
+    }
+
+    VmStatRaw vm;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (read_vmstat(&vm) == 0) {
+        info->oom_kill = vm.oom_kill;
+        if (has_last) {
+            double elapsed = (now.tv_sec - last_time.tv_sec) + (now.tv_nsec - last_time.tv_nsec) / 1e9;
+            if (elapsed > 0) {
+                info->pgfault_rate = (vm.pgfault - last_vm.pgfault) / elapsed;
+                info->pgmajfault_rate = (vm.pgmajfault - last_vm.pgmajfault) / elapsed;
+                info->pswpin_rate = (vm.pswpin - last_vm.pswpin) / elapsed;
+                info->pswpout_rate = (vm.pswpout - last_vm.pswpout) / elapsed;
+            }
+        }
+        last_vm = vm;
+        last_time = now;
+        has_last = 1;
+    }
+
+    get_numa_memory(info->numa_mem, sizeof(info->numa_mem));
 }
 
 // 获取进程数
@@ -457,6 +700,120 @@ int get_connection_count() {
     return count;
 }
 
+// /proc/net/snmp 与 /proc/net/netstat 中关心的协议计数器（累计值）
+typedef struct {
+    unsigned long long tcp_out_segs;
+    unsigned long long tcp_retrans_segs;
+    unsigned long long tcp_out_rsts;
+    unsigned long long tcp_estab_resets;
+    unsigned long long udp_rcvbuf_errors;
+    unsigned long long listen_overflows;
+    unsigned long long listen_drops;
+    unsigned long long syncookies_sent;
+    unsigned long long syncookies_recv;
+} NetProtoRaw;
+
+// 两个文件都是 "段名: 字段名..." 与 "段名: 数值..." 成对出现，按段名和字段名定位
+typedef struct {
+    const char *section;
+    const char *key;
+    size_t offset;
+} ProtoField;
+
+static const ProtoField NET_PROTO_FIELDS[] = {
+    {"Tcp", "OutSegs", offsetof(NetProtoRaw, tcp_out_segs)},
+    {"Tcp", "RetransSegs", offsetof(NetProtoRaw, tcp_retrans_segs)},
+    {"Tcp", "OutRsts", offsetof(NetProtoRaw, tcp_out_rsts)},
+    {"Tcp", "EstabResets", offsetof(NetProtoRaw, tcp_estab_resets)},
+    {"Udp", "RcvbufErrors", offsetof(NetProtoRaw, udp_rcvbuf_errors)},
+    {"TcpExt", "ListenOverflows", offsetof(NetProtoRaw, listen_overflows)},
+    {"TcpExt", "ListenDrops", offsetof(NetProtoRaw, listen_drops)},
+    {"TcpExt", "SyncookiesSent", offsetof(NetProtoRaw, syncookies_sent)},
+    {"TcpExt", "SyncookiesRecv", offsetof(NetProtoRaw, syncookies_recv)},
+    {NULL, NULL, 0}
+};
+
+// 单次遍历解析成对的表头行与数值行，只保留字段表中列出的计数器
+static void parse_proto_buffer(char *buffer, NetProtoRaw *raw) {
+    char *line = buffer;
+    while (line && *line) {
+        char *header = line;
+        char *values = strchr(header, '\n');
+        if (!values) break;
+        *values++ = '\0';
+        line = strchr(values, '\n');
+        if (line) *line++ = '\0';
+
+        char *colon = strchr(header, ':');
+        if (!colon || strncmp(header, values, colon - header + 1) != 0) continue;
+        *colon = '\0';
+
+        char *key_save, *value_save;
+        char *key = strtok_r(colon + 1, " ", &key_save);
+        char *value = strtok_r(values + (colon - header) + 1, " ", &value_save);
+        while (key && value) {
+            for (const ProtoField *f = NET_PROTO_FIELDS; f->section; f++) {
+                if (strcmp(f->section, header) == 0 && strcmp(f->key, key) == 0) {
+                    *(unsigned long long *)((char *)raw + f->offset) = strtoull(value, NULL, 10);
+                    break;
+                }
+            }
+            key = strtok_r(NULL, " ", &key_save);
+            value = strtok_r(NULL, " ", &value_save);
+        }
+    }
+}
+
+static int read_net_proto(NetProtoRaw *raw) {
+    char buffer[16384];
+    int found = 0;
+    memset(raw, 0, sizeof(*raw));
+    if (read_file_to_buffer("/proc/net/snmp", buffer, sizeof(buffer)) >= 0) {
+        parse_proto_buffer(buffer, raw);
+        found = 1;
+    }
+    if (read_file_to_buffer("/proc/net/netstat", buffer, sizeof(buffer)) >= 0) {
+        parse_proto_buffer(buffer, raw);
+        found = 1;
+    }
+    return found ? 0 : -1;
+}
+
+// 计数器差值换算为每秒速率，计数器回绕或被重置时记为 0
+static double counter_rate(unsigned long long current, unsigned long long last, double elapsed) {
+    if (current < last || elapsed <= 0) return 0;
+    return (current - last) / elapsed;
+}
+
+// 获取 TCP/UDP 协议健康指标，速率按两次采集的差值计算
+void get_net_proto_stats(SystemInfo *info) {
+    static NetProtoRaw last;
+    static struct timespec last_time;
+    static int has_last = 0;
+
+    NetProtoRaw cur;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (read_net_proto(&cur) != 0) return;
+
+    if (has_last) {
+        double elapsed = (now.tv_sec - last_time.tv_sec) + (now.tv_nsec - last_time.tv_nsec) / 1e9;
+        double out_segs = counter_rate(cur.tcp_out_segs, last.tcp_out_segs, elapsed);
+        info->tcp_retrans_rate = counter_rate(cur.tcp_retrans_segs, last.tcp_retrans_segs, elapsed);
+        info->tcp_retrans_pct = out_segs > 0 ? info->tcp_retrans_rate * 100.0 / out_segs : 0;
+        info->tcp_out_rst_rate = counter_rate(cur.tcp_out_rsts, last.tcp_out_rsts, elapsed);
+        info->tcp_estab_reset_rate = counter_rate(cur.tcp_estab_resets, last.tcp_estab_resets, elapsed);
+        info->listen_overflow_rate = counter_rate(cur.listen_overflows, last.listen_overflows, elapsed);
+        info->listen_drop_rate = counter_rate(cur.listen_drops, last.listen_drops, elapsed);
+        info->udp_rcvbuf_err_rate = counter_rate(cur.udp_rcvbuf_errors, last.udp_rcvbuf_errors, elapsed);
+        info->syncookie_sent_rate = counter_rate(cur.syncookies_sent, last.syncookies_sent, elapsed);
+        info->syncookie_recv_rate = counter_rate(cur.syncookies_recv, last.syncookies_recv, elapsed);
+    }
+    last = cur;
+    last_time = now;
+    has_last = 1;
+}
+
 // 获取本机IP地址
 char* get_local_ip() {
     struct ifaddrs *ifaddr, *ifa;
@@ -569,26 +926,11 @@ void collect_metrics(SystemInfo *info) {
         fclose(fp);
     }
     
-    // 读取内存信息
-    fp = fopen("/proc/meminfo", "r");
-    if (fp) {
-        char line[256];
-        unsigned long long mem_total = 0, mem_free = 0, mem_available = 0;
-        while (fgets(line, sizeof(line), fp)) {
-            if (sscanf(line, "MemTotal: %llu kB", &mem_total) == 1) continue;
-            if (sscanf(line, "MemFree: %llu kB", &mem_free) == 1) continue;
-            if (sscanf(line, "MemAvailable: %llu kB", &mem_available) == 1) continue;
-        }
-        fclose(fp);
-        
-        info->mem_total = mem_total / 1024.0;  // 转换为 MB
-        info->mem_free = mem_free / 1024.0;
-        info->mem_used = (mem_total - mem_available) / 1024.0;
-    }
-    
-    get_swap_info(&info->swap_total, &info->swap_free);
+    // 读取内存与 VM 统计（包含交换分区）
+    get_memory_stats(info);
     info->process_count = get_process_count();
     info->connection_count = get_connection_count();
+    get_net_proto_stats(info);
     get_system_info(info->system, sizeof(info->system));
     
     // 获取machine-id
@@ -611,71 +953,310 @@ void collect_metrics(SystemInfo *info) {
     strncpy(info->cpu_model, cpu_model, sizeof(info->cpu_model)-1);
 }
 
-// 将 metrics_to_post_data 函数移到 main 函数之前
-char *metrics_to_post_data(const SystemInfo *info) {
-    char *data = malloc(4096);
+void buffer_reset(Buffer *buf) {
+    buf->len = 0;
+    buf->failed = 0;
+    if (buf->data) buf->data[0] = '\0';
+}
+
+void buffer_free(Buffer *buf) {
+    free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+// 确保还能再写入 extra 个字节（外加结尾的 '\0'），容量按 2 倍增长
+static int buffer_reserve(Buffer *buf, size_t extra) {
+    if (buf->failed) return -1;
+    if (buf->len + extra + 1 <= buf->cap) return 0;
+
+    size_t cap = buf->cap ? buf->cap : 1024;
+    while (cap < buf->len + extra + 1) cap *= 2;
+    char *data = realloc(buf->data, cap);
     if (!data) {
-        fprintf(stderr, "Error: Failed to allocate memory for POST data\n");
-        return NULL;
+        buf->failed = 1;
+        return -1;
     }
-    
-    snprintf(data, 4096,
-        "machine_id=%s&"
-        "name=%s&"
-        "system=%s&"
-        "location=%s&"
-        "ip_address=%s&"
-        "uptime=%ld&"
-        "cpu_percent=%.2f&"
-        "net_tx=%lu&"
-        "net_rx=%lu&"
-        "total_tx=%lu&"
-        "total_rx=%lu&"
-        "disks_total_kb=%lu&"
-        "disks_avail_kb=%lu&"
-        "cpu_num_cores=%d&"
-        "mem_total=%.1f&"
-        "mem_free=%.1f&"
-        "mem_used=%.1f&"
-        "swap_total=%.1f&"
-        "swap_free=%.1f&"
-        "process_count=%d&"
-        "connection_count=%d&"
-        "cpu_model=%s",
-        info->machine_id,
-        g_server_name,
-        info->system,
-        g_server_location,
-        info->ip_address,
-        info->uptime,
-        info->cpu_percent,
-        info->net_tx,
-        info->net_rx,
-        info->total_tx,
-        info->total_rx,
-        info->disks_total_kb,
-        info->disks_avail_kb,
-        info->cpu_num_cores,
-        info->mem_total,
-        info->mem_free,
-        info->mem_used,
-        info->swap_total,
-        info->swap_free,
-        info->process_count,
-        info->connection_count,
-        info->cpu_model
-    );
-    
-    return data;
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+static void buffer_append(Buffer *buf, const char *str, size_t n) {
+    if (buffer_reserve(buf, n) != 0) return;
+    memcpy(buf->data + buf->len, str, n);
+    buf->len += n;
+    buf->data[buf->len] = '\0';
+}
+
+static void buffer_puts(Buffer *buf, const char *str) {
+    buffer_append(buf, str, strlen(str));
+}
+
+static void buffer_putc(Buffer *buf, char c) {
+    buffer_append(buf, &c, 1);
+}
+
+// 上报字段的类型，决定取值方式和各编码器的输出格式
+typedef enum {
+    FIELD_STRING,
+    FIELD_INT,
+    FIELD_LONG,
+    FIELD_ULONG,
+    FIELD_DOUBLE
+} FieldType;
+
+// 字段描述表的一项：新增指标只需在 METRIC_FIELDS 中加一行
+typedef struct {
+    const char *name;
+    FieldType type;
+    size_t offset;                 // 在 SystemInfo 中的偏移
+    int precision;                 // 浮点数保留的小数位
+    int tag;                       // 行协议中作为 tag 输出
+    const char *global;            // 非空时取该全局字符串而不是 SystemInfo 中的字段
+} MetricField;
+
+#define METRIC_TAG(f) {#f, FIELD_STRING, offsetof(SystemInfo, f), 0, 1, NULL}
+#define METRIC_STR(f) {#f, FIELD_STRING, offsetof(SystemInfo, f), 0, 0, NULL}
+#define METRIC_INT(f) {#f, FIELD_INT, offsetof(SystemInfo, f), 0, 0, NULL}
+#define METRIC_LONG(f) {#f, FIELD_LONG, offsetof(SystemInfo, f), 0, 0, NULL}
+#define METRIC_ULONG(f) {#f, FIELD_ULONG, offsetof(SystemInfo, f), 0, 0, NULL}
+#define METRIC_DOUBLE(f, p) {#f, FIELD_DOUBLE, offsetof(SystemInfo, f), p, 0, NULL}
+#define METRIC_GLOBAL_TAG(name, var) {name, FIELD_STRING, 0, 0, 1, var}
+
+static const MetricField METRIC_FIELDS[] = {
+    METRIC_TAG(machine_id),
+    METRIC_GLOBAL_TAG("name", g_server_name),
+    METRIC_STR(system),
+    METRIC_GLOBAL_TAG("location", g_server_location),
+    METRIC_STR(ip_address),
+    METRIC_LONG(uptime),
+    METRIC_DOUBLE(cpu_percent, 2),
+    METRIC_ULONG(net_tx),
+    METRIC_ULONG(net_rx),
+    METRIC_ULONG(total_tx),
+    METRIC_ULONG(total_rx),
+    METRIC_ULONG(disks_total_kb),
+    METRIC_ULONG(disks_avail_kb),
+    METRIC_INT(cpu_num_cores),
+    METRIC_DOUBLE(mem_total, 1),
+    METRIC_DOUBLE(mem_free, 1),
+    METRIC_DOUBLE(mem_used, 1),
+    METRIC_DOUBLE(swap_total, 1),
+    METRIC_DOUBLE(swap_free, 1),
+    METRIC_INT(process_count),
+    METRIC_INT(connection_count),
+    METRIC_STR(cpu_model),
+    METRIC_DOUBLE(mem_available, 1),
+    METRIC_DOUBLE(mem_dirty, 1),
+    METRIC_DOUBLE(mem_writeback, 1),
+    METRIC_DOUBLE(mem_slab, 1),
+    METRIC_DOUBLE(mem_shmem, 1),
+    METRIC_ULONG(hugepages_total),
+    METRIC_ULONG(hugepages_free),
+    METRIC_DOUBLE(pgfault_rate, 1),
+    METRIC_DOUBLE(pgmajfault_rate, 1),
+    METRIC_DOUBLE(pswpin_rate, 1),
+    METRIC_DOUBLE(pswpout_rate, 1),
+    METRIC_ULONG(oom_kill),
+    METRIC_STR(numa_mem),
+    METRIC_DOUBLE(tcp_retrans_rate, 2),
+    METRIC_DOUBLE(tcp_retrans_pct, 3),
+    METRIC_DOUBLE(tcp_out_rst_rate, 2),
+    METRIC_DOUBLE(tcp_estab_reset_rate, 2),
+    METRIC_DOUBLE(listen_overflow_rate, 2),
+    METRIC_DOUBLE(listen_drop_rate, 2),
+    METRIC_DOUBLE(udp_rcvbuf_err_rate, 2),
+    METRIC_DOUBLE(syncookie_sent_rate, 2),
+    METRIC_DOUBLE(syncookie_recv_rate, 2),
+    {NULL, FIELD_STRING, 0, 0, 0, NULL}
+};
+
+static const char *field_string(const MetricField *f, const SystemInfo *info) {
+    return f->global ? f->global : (const char *)info + f->offset;
+}
+
+// 将数值字段格式化到 tmp 中，NaN/Inf 统一输出为 0，保证 JSON 和行协议合法
+static const char *field_number(const MetricField *f, const SystemInfo *info, char *tmp, size_t size) {
+    const char *base = (const char *)info + f->offset;
+    switch (f->type) {
+        case FIELD_INT:
+            snprintf(tmp, size, "%d", *(const int *)base);
+            break;
+        case FIELD_LONG:
+            snprintf(tmp, size, "%ld", *(const long *)base);
+            break;
+        case FIELD_ULONG:
+            snprintf(tmp, size, "%lu", *(const unsigned long *)base);
+            break;
+        case FIELD_DOUBLE: {
+            double value = *(const double *)base;
+            snprintf(tmp, size, "%.*f", f->precision, isfinite(value) ? value : 0.0);
+            break;
+        }
+        default:
+            tmp[0] = '\0';
+    }
+    return tmp;
+}
+
+// application/x-www-form-urlencoded：除 RFC 3986 非保留字符外全部百分号编码
+static void form_escape(Buffer *buf, const char *str) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z') || (*p >= '0' && *p <= '9') ||
+            *p == '-' || *p == '.' || *p == '_' || *p == '~') {
+            buffer_putc(buf, *p);
+        } else {
+            char enc[3] = {'%', hex[*p >> 4], hex[*p & 0x0F]};
+            buffer_append(buf, enc, sizeof(enc));
+        }
+    }
+}
+
+static void encode_form(Buffer *buf, const SystemInfo *info) {
+    char tmp[64];
+    for (const MetricField *f = METRIC_FIELDS; f->name; f++) {
+        if (f != METRIC_FIELDS) buffer_putc(buf, '&');
+        buffer_puts(buf, f->name);
+        buffer_putc(buf, '=');
+        if (f->type == FIELD_STRING) {
+            form_escape(buf, field_string(f, info));
+        } else {
+            buffer_puts(buf, field_number(f, info, tmp, sizeof(tmp)));
+        }
+    }
+}
+
+// JSON 字符串转义，控制字符输出为 \u00XX
+static void json_escape(Buffer *buf, const char *str) {
+    buffer_putc(buf, '"');
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            buffer_putc(buf, '\\');
+            buffer_putc(buf, *p);
+        } else if (*p < 0x20) {
+            char enc[7];
+            snprintf(enc, sizeof(enc), "\\u%04x", *p);
+            buffer_append(buf, enc, 6);
+        } else {
+            buffer_putc(buf, *p);
+        }
+    }
+    buffer_putc(buf, '"');
+}
+
+static void encode_json(Buffer *buf, const SystemInfo *info) {
+    char tmp[64];
+    buffer_putc(buf, '{');
+    for (const MetricField *f = METRIC_FIELDS; f->name; f++) {
+        if (f != METRIC_FIELDS) buffer_putc(buf, ',');
+        json_escape(buf, f->name);
+        buffer_putc(buf, ':');
+        if (f->type == FIELD_STRING) {
+            json_escape(buf, field_string(f, info));
+        } else {
+            buffer_puts(buf, field_number(f, info, tmp, sizeof(tmp)));
+        }
+    }
+    buffer_putc(buf, '}');
+}
+
+// InfluxDB 行协议：tag 值转义逗号、等号、空格和反斜杠（否则末尾的反斜杠会吞掉后面的分隔符），
+// 字段字符串转义双引号和反斜杠，换行替换为空格
+static void influx_escape(Buffer *buf, const char *str, int is_tag) {
+    for (const char *p = str; *p; p++) {
+        if (*p == '\n' || *p == '\r') {
+            buffer_putc(buf, is_tag ? '_' : ' ');
+            continue;
+        }
+        if (is_tag ? (*p == ',' || *p == '=' || *p == ' ' || *p == '\\') : (*p == '"' || *p == '\\')) {
+            buffer_putc(buf, '\\');
+        }
+        buffer_putc(buf, *p);
+    }
+}
+
+static void encode_influx(Buffer *buf, const SystemInfo *info) {
+    char tmp[64];
+    buffer_puts(buf, "zsan");
+    for (const MetricField *f = METRIC_FIELDS; f->name; f++) {
+        const char *value = f->tag ? field_string(f, info) : NULL;
+        if (!value || !*value) continue;   // 行协议不允许空的 tag 值
+        buffer_putc(buf, ',');
+        buffer_puts(buf, f->name);
+        buffer_putc(buf, '=');
+        influx_escape(buf, value, 1);
+    }
+
+    char sep = ' ';
+    for (const MetricField *f = METRIC_FIELDS; f->name; f++) {
+        if (f->tag) continue;
+        buffer_putc(buf, sep);
+        sep = ',';
+        buffer_puts(buf, f->name);
+        buffer_putc(buf, '=');
+        if (f->type == FIELD_STRING) {
+            buffer_putc(buf, '"');
+            influx_escape(buf, field_string(f, info), 0);
+            buffer_putc(buf, '"');
+        } else {
+            buffer_puts(buf, field_number(f, info, tmp, sizeof(tmp)));
+            if (f->type != FIELD_DOUBLE) buffer_putc(buf, 'i');
+        }
+    }
+    buffer_putc(buf, '\n');
+}
+
+static const PayloadEncoder PAYLOAD_ENCODERS[] = {
+    {"form", "application/x-www-form-urlencoded", encode_form},
+    {"json", "application/json", encode_json},
+    {"influx", "text/plain; charset=utf-8", encode_influx},
+    {NULL, NULL, NULL}
+};
+
+// 按名称查找编码器，未知名称返回 NULL
+const PayloadEncoder *find_encoder(const char *name) {
+    for (const PayloadEncoder *e = PAYLOAD_ENCODERS; e->name; e++) {
+        if (strcmp(e->name, name) == 0) return e;
+    }
+    return NULL;
+}
+
+// 将监控数据编码到 buf（先清空），成功返回 0，内存不足返回 -1
+int serialize_metrics(const SystemInfo *info, const PayloadEncoder *encoder, Buffer *buf) {
+    buffer_reset(buf);
+    encoder->encode(buf, info);
+    return buf->failed ? -1 : 0;
 }
 
 // 修改 send_post_request 函数，添加响应解析
-int send_post_request(const char *url, const char *data) {
+int send_post_request(const char *url, const char *data, size_t len, const char *content_type) {
     // 添加重试计数器
     int retry_count = 0;
     const int max_retries = 3;
     const int retry_delay = 5; // seconds
-    
+
+    // 请求体写入临时文件，由 curl --data-binary 原样发送，不经过 shell 转义，也不受命令行长度限制
+    char payload_file[] = "/tmp/zsan_payload_XXXXXX";
+    int payload_fd = mkstemp(payload_file);
+    if (payload_fd == -1) {
+        log_message("ERROR", "Failed to create temporary file: %s", strerror(errno));
+        return -1;
+    }
+    size_t written = 0;
+    while (written < len) {
+        ssize_t n = write(payload_fd, data + written, len - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            log_message("ERROR", "Failed to write payload: %s", strerror(errno));
+            close(payload_fd);
+            unlink(payload_file);
+            return -1;
+        }
+        written += n;
+    }
+    close(payload_fd);
+
     while (retry_count < max_retries) {
         char command[4096];
         char response[4096];
@@ -685,25 +1266,50 @@ int send_post_request(const char *url, const char *data) {
         int temp_fd = mkstemp(temp_file);
         if (temp_fd == -1) {
             log_message("ERROR", "Failed to create temporary file: %s", strerror(errno));
+            unlink(payload_file);
             return -1;
         }
         close(temp_fd);
         
-        // 修改 curl 命令以保存响应并格式化 JSON
-        snprintf(command, sizeof(command), 
-                "curl -X POST -d '%s' '%s' --connect-timeout 10 --max-time 30 -s | python3 -m json.tool > %s",
-                data, url, temp_file);
-                
-        int result = system(command);
-        if (result == 0) {
+        // 按 HTTP 状态码判断结果：响应体写入临时文件，curl 只输出状态码。
+        // 不依赖响应体格式，InfluxDB 等返回 204 空响应的接收端同样视为成功
+        snprintf(command, sizeof(command),
+                "curl -X POST -H 'Content-Type: %s' --data-binary @%s '%s' --connect-timeout 10 --max-time 30 -sS -o %s -w '%%{http_code}'",
+                content_type, payload_file, url, temp_file);
+
+        int http_code = 0;
+        FILE *pipe = popen(command, "r");
+        if (pipe) {
+            if (fscanf(pipe, "%d", &http_code) != 1) http_code = 0;
+            pclose(pipe);
+        }
+
+        // 读取响应开头用于日志
+        response[0] = '\0';
+        FILE *resp_fp = fopen(temp_file, "r");
+        if (resp_fp) {
+            size_t n = fread(response, 1, sizeof(response) - 1, resp_fp);
+            response[n] = '\0';
+            fclose(resp_fp);
+        }
+        unlink(temp_file);
+
+        if (http_code >= 200 && http_code < 300) {
+            unlink(payload_file);
             return 0; // 成功
         }
-        
-        log_message("WARN", "发送数据失败,尝试重试 %d/%d", retry_count + 1, max_retries);
+        // 4xx（429 除外）说明请求本身被拒绝，重试同样的数据不会成功
+        if (http_code >= 400 && http_code < 500 && http_code != 429) {
+            log_message("ERROR", "服务端拒绝上报数据 (HTTP %d): %.200s", http_code, response);
+            break;
+        }
+
+        log_message("WARN", "发送数据失败 (HTTP %d),尝试重试 %d/%d", http_code, retry_count + 1, max_retries);
         sleep(retry_delay);
         retry_count++;
     }
-    
+
+    unlink(payload_file);
     return -1; // 所有重试都失败
 }
 
@@ -771,6 +1377,8 @@ static void safe_strncpy(char *dest, const char *src, size_t size) {
 }
 
 // main 函数和其他代码保持不变
+// 定义 ZSAN_NO_MAIN 后可被其他工具（如 zsan_load.c）直接包含以复用采集与序列化代码
+#ifndef ZSAN_NO_MAIN
 int main(int argc, char *argv[]) {
     // 检查日志文件权限
     FILE *test_log = fopen("/var/log/zsan/zsan.log", "a");
@@ -788,6 +1396,7 @@ int main(int argc, char *argv[]) {
     
     int interval = 10;
     char url[256] = "";
+    const PayloadEncoder *encoder = find_encoder("form");
     int opt;
     
     // 从环境变量读取服务器名称和位置
@@ -850,7 +1459,7 @@ int main(int argc, char *argv[]) {
         }
     }
     
-    while ((opt = getopt(argc, argv, "s:u:")) != -1) {
+    while ((opt = getopt(argc, argv, "s:u:f:")) != -1) {
         switch (opt) {
             case 's':
                 interval = atoi(optarg);
@@ -858,37 +1467,44 @@ int main(int argc, char *argv[]) {
             case 'u':
                 strncpy(url, optarg, sizeof(url) - 1);
                 break;
+            case 'f':
+                encoder = find_encoder(optarg);
+                if (!encoder) {
+                    fprintf(stderr, "Error: unknown format '%s' (form, json, influx)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             default:
-                fprintf(stderr, "Usage: %s -s <interval> -u <url>\n", argv[0]);
+                fprintf(stderr, "Usage: %s -s <interval> -u <url> [-f form|json|influx]\n", argv[0]);
                 exit(EXIT_FAILURE);
         }
     }
     if (strlen(url) == 0) {
         fprintf(stderr, "Error: -u <url> is required.\n");
-        fprintf(stderr, "Usage: %s -s <interval> -u <url>\n", argv[0]);
+        fprintf(stderr, "Usage: %s -s <interval> -u <url> [-f form|json|influx]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
     
     log_message("INFO", "zsan client starting up...");
     log_message("INFO", "Version: 0.0.1");
     
+    Buffer payload = {0};
     while (1) {
         SystemInfo info = {0};
         collect_metrics(&info);
-        char *post_data = metrics_to_post_data(&info);
-        if (!post_data) {
+        if (serialize_metrics(&info, encoder, &payload) != 0) {
             log_message("ERROR", "Failed to prepare POST data");
             sleep(interval);
             continue;
         }
-        
+
         log_message("INFO", "Sending metrics to %s", url);
-        if (send_post_request(url, post_data) != 0) {
+        if (send_post_request(url, payload.data, payload.len, encoder->content_type) != 0) {
             log_message("ERROR", "Failed to send data to %s", url);
         }
-        
-        free(post_data);
+
         sleep(interval);
     }
     return 0;
 }
+#endif
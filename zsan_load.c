@@ -0,0 +1,798 @@
+// zsan 压力测试工具
+// 在单个进程内用事件循环模拟大量虚拟客户端，按 zsan 客户端相同的格式上报数据，
+// 统计持续吞吐、延迟分位数和错误率；也可作为本地模拟接收端（-m）使用。
+//
+// 编译：gcc -O2 -o zsan_load zsan_load.c
+// 压测：./zsan_load -u http://127.0.0.1:8787/status -n 5000 -s 10 -d 120
+// 接收：./zsan_load -m 8787
+#define _GNU_SOURCE
+#define ZSAN_NO_MAIN
+#include "zsan.c"
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define LOAD_VERSION "0.0.1"
+#define MAX_EVENTS 512
+#define REQ_BUF_SIZE 8192
+#define HDR_BUF_SIZE 1024
+#define LAT_BUCKET_US 100              // 延迟直方图精度（微秒）
+#define LAT_BUCKETS 100000             // 覆盖 0 ~ 10 秒，超出记入最后一个桶
+#define REQUEST_TIMEOUT_MS 30000       // 与客户端 curl --max-time 30 保持一致
+
+// 虚拟客户端
+typedef struct {
+    SystemInfo info;
+    char name[64];
+    double next_due;                   // 下次上报时间（毫秒，单调时钟）
+    double cpu_base;                   // CPU 使用率的基准值，随机游走围绕它波动
+    unsigned int seed;
+} VirtualAgent;
+
+// 正在进行中的请求
+typedef struct {
+    int fd;
+    int agent;
+    int connected;
+    double start;                      // 请求开始时间（毫秒）
+    char req[REQ_BUF_SIZE];
+    size_t req_len;
+    size_t req_off;
+    char hdr[HDR_BUF_SIZE];            // 仅保留响应头部用于解析
+    size_t hdr_len;
+    int status;                        // HTTP 状态码，未解析时为 0
+    long content_length;               // -1 表示未知（读到连接关闭为止）
+    size_t body_len;
+    int chunked;
+    char tail[5];                      // chunked 响应的最后 5 个字节
+} LoadConn;
+
+// 压测目标
+typedef struct {
+    char host[256];
+    char port[8];
+    char path[256];
+    char authority[272];               // Host 头：非 80 端口时带上 :port
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+} LoadTarget;
+
+// 统计数据
+typedef struct {
+    unsigned long sent;
+    unsigned long ok;
+    unsigned long err_connect;
+    unsigned long err_timeout;
+    unsigned long err_4xx;
+    unsigned long err_429;
+    unsigned long err_5xx;
+    unsigned long err_other;
+    double max_lag;                    // 实际发出时间相对计划时间的最大滞后（毫秒）
+    unsigned int lat_hist[LAT_BUCKETS];
+} LoadStats;
+
+static volatile sig_atomic_t g_stop = 0;
+static LoadTarget g_target;
+static LoadStats g_stats;
+static VirtualAgent *g_agents;
+static int *g_heap;                    // 按 next_due 排序的最小堆
+static int g_heap_size;
+static LoadConn *g_conns;
+static int g_max_conns = 256;
+static int g_active;
+static int g_interval = 10;
+static const PayloadEncoder *g_encoder;
+static Buffer g_payload;               // 所有请求复用同一块序列化缓冲区
+
+static const char *k_systems[] = {
+    "Ubuntu 22.04.4 LTS", "Debian GNU/Linux 12 (bookworm)", "CentOS Linux 7 (Core)",
+    "Rocky Linux 9.3 (Blue Onyx)", "Alpine Linux v3.19"
+};
+static const char *k_cpu_models[] = {
+    "Intel(R) Xeon(R) Platinum 8272CL CPU @ 2.60GHz", "AMD EPYC 7B13 64-Core Processor",
+    "Intel(R) Xeon(R) CPU E5-2680 v4 @ 2.40GHz", "AMD EPYC 9654 96-Core Processor"
+};
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static double rand_unit(unsigned int *seed) {
+    return rand_r(seed) / (double)RAND_MAX;
+}
+
+// 解析 http://host[:port]/path 形式的地址，仅支持明文 HTTP
+static int parse_target(const char *url, LoadTarget *target) {
+    const char *p = url;
+    if (strncmp(p, "http://", 7) != 0) {
+        fprintf(stderr, "Error: only http:// URLs are supported\n");
+        return -1;
+    }
+    p += 7;
+
+    const char *path = strchr(p, '/');
+    size_t host_len = path ? (size_t)(path - p) : strlen(p);
+    if (host_len == 0 || host_len >= sizeof(target->host)) {
+        fprintf(stderr, "Error: invalid host in %s\n", url);
+        return -1;
+    }
+    memcpy(target->host, p, host_len);
+    target->host[host_len] = '\0';
+    safe_strncpy(target->path, path ? path : "/", sizeof(target->path));
+
+    char *colon = strrchr(target->host, ':');
+    if (colon) {
+        *colon = '\0';
+        safe_strncpy(target->port, colon + 1, sizeof(target->port));
+    } else {
+        safe_strncpy(target->port, "80", sizeof(target->port));
+    }
+    if (strcmp(target->port, "80") == 0) {
+        safe_strncpy(target->authority, target->host, sizeof(target->authority));
+    } else {
+        snprintf(target->authority, sizeof(target->authority), "%s:%s", target->host, target->port);
+    }
+
+    struct addrinfo hints = {0}, *res;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int rc = getaddrinfo(target->host, target->port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "Error: cannot resolve %s: %s\n", target->host, gai_strerror(rc));
+        return -1;
+    }
+    memcpy(&target->addr, res->ai_addr, res->ai_addrlen);
+    target->addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+// 最小堆操作
+static void heap_swap(int i, int j) {
+    int t = g_heap[i];
+    g_heap[i] = g_heap[j];
+    g_heap[j] = t;
+}
+
+static void heap_push(int agent) {
+    int i = g_heap_size++;
+    g_heap[i] = agent;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (g_agents[g_heap[parent]].next_due <= g_agents[g_heap[i]].next_due) break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static int heap_pop(void) {
+    int top = g_heap[0];
+    g_heap[0] = g_heap[--g_heap_size];
+    int i = 0;
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < g_heap_size && g_agents[g_heap[l]].next_due < g_agents[g_heap[m]].next_due) m = l;
+        if (r < g_heap_size && g_agents[g_heap[r]].next_due < g_agents[g_heap[m]].next_due) m = r;
+        if (m == i) break;
+        heap_swap(i, m);
+        i = m;
+    }
+    return top;
+}
+
+// 初始化虚拟客户端的静态信息和初始指标
+static void agent_init(VirtualAgent *a, int index, unsigned int salt, double start) {
+    SystemInfo *info = &a->info;
+    a->seed = salt ^ (unsigned int)(index * 2654435761u);
+
+    snprintf(a->name, sizeof(a->name), "load-%05d", index);
+    snprintf(info->machine_id, sizeof(info->machine_id), "%08x%024x", salt, (unsigned int)index);
+    snprintf(info->ip_address, sizeof(info->ip_address), "10.%d.%d.%d",
+             (index >> 16) & 0xff, (index >> 8) & 0xff, index & 0xff);
+    safe_strncpy(info->system, k_systems[rand_r(&a->seed) % 5], sizeof(info->system));
+    safe_strncpy(info->cpu_model, k_cpu_models[rand_r(&a->seed) % 4], sizeof(info->cpu_model));
+
+    info->cpu_num_cores = 1 << (rand_r(&a->seed) % 6);
+    info->mem_total = 512.0 * (1 << (rand_r(&a->seed) % 8));
+    info->mem_used = info->mem_total * (0.2 + 0.5 * rand_unit(&a->seed));
+    info->mem_free = info->mem_total * 0.1;
+    info->swap_total = info->mem_total / 2;
+    info->swap_free = info->swap_total;
+    info->disks_total_kb = 20UL * 1024 * 1024 * (1 + rand_r(&a->seed) % 50);
+    info->disks_avail_kb = info->disks_total_kb / 2;
+    info->uptime = rand_r(&a->seed) % (90 * 86400);
+    info->process_count = 80 + rand_r(&a->seed) % 300;
+    info->connection_count = rand_r(&a->seed) % 500;
+    a->cpu_base = 5 + 60 * rand_unit(&a->seed);
+    info->cpu_percent = a->cpu_base;
+
+    // 首次上报时间在一个周期内均匀分布，避免所有客户端同时启动
+    a->next_due = start + g_interval * 1000.0 * rand_unit(&a->seed);
+}
+
+// 每次上报前演化指标，模拟真实服务器的波动
+static void agent_evolve(VirtualAgent *a) {
+    SystemInfo *info = &a->info;
+    double cpu = info->cpu_percent + (rand_unit(&a->seed) - 0.5) * 10 + (a->cpu_base - info->cpu_percent) * 0.1;
+    info->cpu_percent = cpu < 0 ? 0 : (cpu > 100 ? 100 : cpu);
+
+    double mem = info->mem_used + (rand_unit(&a->seed) - 0.5) * info->mem_total * 0.02;
+    if (mem < info->mem_total * 0.05) mem = info->mem_total * 0.05;
+    if (mem > info->mem_total * 0.95) mem = info->mem_total * 0.95;
+    info->mem_used = mem;
+    info->mem_free = (info->mem_total - mem) * 0.3;
+
+    info->net_tx = (unsigned long)(info->cpu_percent * 20000 * rand_unit(&a->seed));
+    info->net_rx = (unsigned long)(info->cpu_percent * 40000 * rand_unit(&a->seed));
+    info->total_tx += info->net_tx * g_interval;
+    info->total_rx += info->net_rx * g_interval;
+    info->uptime += g_interval;
+
+    if (info->disks_avail_kb > 1024) info->disks_avail_kb -= rand_r(&a->seed) % 1024;
+    info->process_count += (int)(rand_r(&a->seed) % 7) - 3;
+    if (info->process_count < 10) info->process_count = 10;
+    info->connection_count += (int)(rand_r(&a->seed) % 11) - 5;
+    if (info->connection_count < 0) info->connection_count = 0;
+}
+
+// 按 HTTP/1.1 拼装一次上报请求，body 与 zsan 客户端完全一致
+static int build_request(LoadConn *c, VirtualAgent *a) {
+    safe_strncpy(g_server_name, a->name, sizeof(g_server_name));
+    if (serialize_metrics(&a->info, g_encoder, &g_payload) != 0) return -1;
+
+    int n = snprintf(c->req, sizeof(c->req),
+                     "POST %s HTTP/1.1\r\n"
+                     "Host: %s\r\n"
+                     "User-Agent: zsan-load/" LOAD_VERSION "\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Connection: close\r\n"
+                     "\r\n"
+                     "%s",
+                     g_target.path, g_target.authority, g_encoder->content_type, g_payload.len, g_payload.data);
+    if (n < 0 || (size_t)n >= sizeof(c->req)) return -1;
+    c->req_len = n;
+    return 0;
+}
+
+static void record_latency(double ms) {
+    long bucket = (long)(ms * 1000 / LAT_BUCKET_US);
+    if (bucket < 0) bucket = 0;
+    if (bucket >= LAT_BUCKETS) bucket = LAT_BUCKETS - 1;
+    g_stats.lat_hist[bucket]++;
+}
+
+static double latency_percentile(double p) {
+    unsigned long total = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++) total += g_stats.lat_hist[i];
+    if (total == 0) return 0;
+
+    unsigned long rank = (unsigned long)(total * p);
+    if (rank >= total) rank = total - 1;
+    unsigned long seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++) {
+        seen += g_stats.lat_hist[i];
+        if (seen > rank) return (i + 1) * LAT_BUCKET_US / 1000.0;
+    }
+    return LAT_BUCKETS * LAT_BUCKET_US / 1000.0;
+}
+
+static void conn_close(int epfd, LoadConn *c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    g_active--;
+}
+
+// 请求结束：记录结果并释放连接槽位
+static void conn_finish(int epfd, LoadConn *c, double now) {
+    if (c->status >= 200 && c->status < 300) {
+        g_stats.ok++;
+        record_latency(now - c->start);
+    } else if (c->status == 429) {
+        g_stats.err_429++;
+    } else if (c->status >= 400 && c->status < 500) {
+        g_stats.err_4xx++;
+    } else if (c->status >= 500) {
+        g_stats.err_5xx++;
+    } else {
+        g_stats.err_other++;
+    }
+    conn_close(epfd, c);
+}
+
+static int start_request(int epfd, int slot, int agent, double now) {
+    LoadConn *c = &g_conns[slot];
+    c->agent = agent;
+    c->connected = 0;
+    c->start = now;
+    c->req_off = 0;
+    c->hdr_len = 0;
+    c->status = 0;
+    c->content_length = -1;
+    c->body_len = 0;
+    c->chunked = 0;
+    memset(c->tail, 0, sizeof(c->tail));
+
+    agent_evolve(&g_agents[agent]);
+    if (build_request(c, &g_agents[agent]) != 0) {
+        g_stats.err_other++;
+        c->fd = -1;
+        return -1;
+    }
+
+    c->fd = socket(g_target.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (c->fd < 0) {
+        g_stats.err_connect++;
+        return -1;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(c->fd, (struct sockaddr *)&g_target.addr, g_target.addr_len) != 0 &&
+        errno != EINPROGRESS) {
+        g_stats.err_connect++;
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = EPOLLOUT, .data.u32 = slot };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    g_active++;
+    g_stats.sent++;
+    return 0;
+}
+
+// 解析已收到的响应头，得到状态码与 body 长度
+static void parse_response_header(LoadConn *c, size_t header_end) {
+    c->hdr[header_end] = '\0';
+    sscanf(c->hdr, "HTTP/%*s %d", &c->status);
+
+    char *line = strstr(c->hdr, "\r\n");
+    while (line && line < c->hdr + header_end) {
+        line += 2;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            c->content_length = strtol(line + 15, NULL, 10);
+        } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked")) {
+            c->chunked = 1;
+        }
+        line = strstr(line, "\r\n");
+    }
+}
+
+// 处理收到的数据，返回 1 表示响应已完整
+static int consume_response(LoadConn *c, const char *data, size_t len) {
+    if (c->status == 0) {
+        size_t copy = len;
+        if (copy > sizeof(c->hdr) - 1 - c->hdr_len) copy = sizeof(c->hdr) - 1 - c->hdr_len;
+        memcpy(c->hdr + c->hdr_len, data, copy);
+        c->hdr_len += copy;
+        c->hdr[c->hdr_len] = '\0';
+
+        char *end = strstr(c->hdr, "\r\n\r\n");
+        if (!end) return 0;
+        size_t header_end = end - c->hdr + 4;
+        size_t prev_len = c->hdr_len - copy;
+        parse_response_header(c, header_end);
+        if (c->status == 0) c->status = -1;
+
+        data += header_end - prev_len;
+        len -= header_end - prev_len;
+    }
+
+    c->body_len += len;
+    if (c->chunked) {
+        for (size_t i = 0; i < len; i++) {
+            memmove(c->tail, c->tail + 1, sizeof(c->tail) - 1);
+            c->tail[sizeof(c->tail) - 1] = data[i];
+        }
+        return memcmp(c->tail, "0\r\n\r\n", 5) == 0;
+    }
+    return c->content_length >= 0 && (long)c->body_len >= c->content_length;
+}
+
+static void handle_conn_event(int epfd, int slot, uint32_t events, double now) {
+    LoadConn *c = &g_conns[slot];
+    if (c->fd < 0) return;
+
+    if (!c->connected && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            g_stats.err_connect++;
+            conn_close(epfd, c);
+            return;
+        }
+        c->connected = 1;
+    }
+
+    if (events & EPOLLOUT) {
+        while (c->req_off < c->req_len) {
+            ssize_t n = write(c->fd, c->req + c->req_off, c->req_len - c->req_off);
+            if (n < 0) {
+                if (errno == EAGAIN) return;
+                g_stats.err_other++;
+                conn_close(epfd, c);
+                return;
+            }
+            c->req_off += n;
+        }
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = slot };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        char buf[4096];
+        for (;;) {
+            ssize_t n = read(c->fd, buf, sizeof(buf));
+            if (n > 0) {
+                if (consume_response(c, buf, n)) {
+                    conn_finish(epfd, c, now);
+                    return;
+                }
+                continue;
+            }
+            if (n == 0) {
+                // 对端关闭：未知长度的响应以此为结束
+                conn_finish(epfd, c, now);
+                return;
+            }
+            if (errno == EAGAIN) return;
+            g_stats.err_other++;
+            conn_close(epfd, c);
+            return;
+        }
+    }
+}
+
+static int find_free_slot(void) {
+    static int hint = 0;
+    for (int i = 0; i < g_max_conns; i++) {
+        int slot = (hint + i) % g_max_conns;
+        if (g_conns[slot].fd < 0) {
+            hint = slot + 1;
+            return slot;
+        }
+    }
+    return -1;
+}
+
+static unsigned long total_errors(void) {
+    return g_stats.err_connect + g_stats.err_timeout + g_stats.err_4xx +
+           g_stats.err_429 + g_stats.err_5xx + g_stats.err_other;
+}
+
+static void print_progress(double elapsed_s, unsigned long ok_delta, unsigned long err_delta) {
+    printf("[%6.0fs] ok/s=%-7lu err/s=%-5lu inflight=%-5d p50=%.1fms p99=%.1fms lag_max=%.0fms\n",
+           elapsed_s, ok_delta, err_delta, g_active,
+           latency_percentile(0.50), latency_percentile(0.99), g_stats.max_lag);
+    fflush(stdout);
+}
+
+static void print_summary(double elapsed_s, int agents) {
+    unsigned long errors = total_errors();
+    unsigned long done = g_stats.ok + errors;
+    printf("\n==== zsan 压测结果 ====\n");
+    printf("目标:        http://%s:%s%s\n", g_target.host, g_target.port, g_target.path);
+    printf("虚拟客户端:  %d (上报间隔 %ds，理论 %.1f req/s)\n",
+           agents, g_interval, agents / (double)g_interval);
+    printf("持续时间:    %.1fs\n", elapsed_s);
+    printf("请求:        sent=%lu done=%lu ok=%lu\n", g_stats.sent, done, g_stats.ok);
+    printf("吞吐:        %.1f req/s (成功 %.1f req/s)\n",
+           done / elapsed_s, g_stats.ok / elapsed_s);
+    printf("延迟:        p50=%.1fms p90=%.1fms p99=%.1fms p999=%.1fms\n",
+           latency_percentile(0.50), latency_percentile(0.90),
+           latency_percentile(0.99), latency_percentile(0.999));
+    printf("错误率:      %.2f%% (connect=%lu timeout=%lu 429=%lu 4xx=%lu 5xx=%lu other=%lu)\n",
+           done ? errors * 100.0 / done : 0.0,
+           g_stats.err_connect, g_stats.err_timeout, g_stats.err_429,
+           g_stats.err_4xx, g_stats.err_5xx, g_stats.err_other);
+    printf("调度滞后:    max=%.0fms (大于 0 说明并发上限 -c 不足或目标已饱和)\n", g_stats.max_lag);
+}
+
+static int run_load(const char *url, int agents, int duration, unsigned int salt) {
+    if (parse_target(url, &g_target) != 0) return 1;
+
+    g_agents = calloc(agents, sizeof(VirtualAgent));
+    g_heap = calloc(agents, sizeof(int));
+    g_conns = calloc(g_max_conns, sizeof(LoadConn));
+    if (!g_agents || !g_heap || !g_conns) {
+        fprintf(stderr, "Error: failed to allocate %d agents\n", agents);
+        return 1;
+    }
+    for (int i = 0; i < g_max_conns; i++) g_conns[i].fd = -1;
+
+    int epfd = epoll_create1(0);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+
+    double start = now_ms();
+    for (int i = 0; i < agents; i++) {
+        agent_init(&g_agents[i], i, salt, start);
+        heap_push(i);
+    }
+
+    printf("zsan-load %s: %d agents -> %s (interval=%ds, concurrency=%d, duration=%ds)\n",
+           LOAD_VERSION, agents, url, g_interval, g_max_conns, duration);
+
+    struct epoll_event events[MAX_EVENTS];
+    double end = start + duration * 1000.0;
+    double next_report = start + 1000;
+    unsigned long last_ok = 0, last_err = 0;
+
+    while (!g_stop) {
+        double now = now_ms();
+        if (now >= end && g_active == 0) break;
+
+        // 派发到期的虚拟客户端
+        while (now < end && g_heap_size > 0 && g_agents[g_heap[0]].next_due <= now) {
+            int slot = find_free_slot();
+            if (slot < 0) break;
+            int agent = heap_pop();
+            VirtualAgent *a = &g_agents[agent];
+            if (now - a->next_due > g_stats.max_lag) g_stats.max_lag = now - a->next_due;
+
+            start_request(epfd, slot, agent, now);
+            // 下次计划时间基于本次计划时间加 ±10% 抖动，保持稳定的期望负载
+            a->next_due += g_interval * 1000.0 * (0.9 + 0.2 * rand_unit(&a->seed));
+            heap_push(agent);
+        }
+
+        int timeout = 100;
+        if (g_heap_size > 0 && g_active < g_max_conns) {
+            double wait = g_agents[g_heap[0]].next_due - now;
+            if (wait < timeout) timeout = wait < 0 ? 0 : (int)wait + 1;
+        }
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+        now = now_ms();
+        for (int i = 0; i < n; i++) {
+            handle_conn_event(epfd, events[i].data.u32, events[i].events, now);
+        }
+
+        if (now >= next_report) {
+            // 顺带清理超时请求
+            for (int i = 0; i < g_max_conns; i++) {
+                if (g_conns[i].fd >= 0 && now - g_conns[i].start > REQUEST_TIMEOUT_MS) {
+                    g_stats.err_timeout++;
+                    conn_close(epfd, &g_conns[i]);
+                }
+            }
+            unsigned long errors = total_errors();
+            print_progress((now - start) / 1000, g_stats.ok - last_ok, errors - last_err);
+            last_ok = g_stats.ok;
+            last_err = errors;
+            next_report += 1000;
+        }
+    }
+
+    print_summary((now_ms() - start) / 1000, agents);
+    close(epfd);
+    free(g_conns);
+    free(g_heap);
+    free(g_agents);
+    buffer_free(&g_payload);
+    return 0;
+}
+
+// 模拟接收端：只解析 HTTP 头与 Content-Length，读完 body 即返回成功响应
+typedef struct {
+    char buf[HDR_BUF_SIZE];
+    size_t len;
+    long need;                         // 头部 + body 总长度，未知时为 -1
+    size_t total;
+} MockConn;
+
+static int run_mock_server(int port) {
+    int lfd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (lfd < 0) {
+        perror("socket");
+        return 1;
+    }
+    int one = 1, zero = 0;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(lfd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+
+    struct sockaddr_in6 addr = {0};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, 4096) != 0) {
+        perror("bind/listen");
+        close(lfd);
+        return 1;
+    }
+
+    int epfd = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = lfd };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+
+    size_t cap = 1024;
+    MockConn *conns = calloc(cap, sizeof(MockConn));
+    if (!conns) return 1;
+
+    static const char response[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 16\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "{\"success\":true}";
+
+    printf("zsan-load %s: mock ingest listening on :%d\n", LOAD_VERSION, port);
+    fflush(stdout);
+
+    struct epoll_event events[MAX_EVENTS];
+    unsigned long served = 0, last_served = 0;
+    double start = now_ms(), next_report = start + 1000;
+
+    while (!g_stop) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 1000);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == lfd) {
+                int cfd;
+                while ((cfd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+                    if ((size_t)cfd >= cap) {
+                        size_t new_cap = cap;
+                        while ((size_t)cfd >= new_cap) new_cap *= 2;
+                        MockConn *grown = realloc(conns, new_cap * sizeof(MockConn));
+                        if (!grown) {
+                            close(cfd);
+                            continue;
+                        }
+                        memset(grown + cap, 0, (new_cap - cap) * sizeof(MockConn));
+                        conns = grown;
+                        cap = new_cap;
+                    }
+                    conns[cfd].len = 0;
+                    conns[cfd].total = 0;
+                    conns[cfd].need = -1;
+                    struct epoll_event cev = { .events = EPOLLIN, .data.fd = cfd };
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &cev);
+                }
+                continue;
+            }
+
+            MockConn *c = &conns[fd];
+            char buf[4096];
+            int done = 0, closed = 0;
+            for (;;) {
+                ssize_t r = read(fd, buf, sizeof(buf));
+                if (r > 0) {
+                    c->total += r;
+                    if (c->need < 0) {
+                        size_t copy = r;
+                        if (copy > sizeof(c->buf) - 1 - c->len) copy = sizeof(c->buf) - 1 - c->len;
+                        memcpy(c->buf + c->len, buf, copy);
+                        c->len += copy;
+                        c->buf[c->len] = '\0';
+                        char *end = strstr(c->buf, "\r\n\r\n");
+                        if (end) {
+                            char *cl = strcasestr(c->buf, "Content-Length:");
+                            c->need = (end - c->buf) + 4 + (cl && cl < end ? strtol(cl + 15, NULL, 10) : 0);
+                        }
+                    }
+                    if (c->need >= 0 && (long)c->total >= c->need) {
+                        done = 1;
+                        break;
+                    }
+                    continue;
+                }
+                if (r == 0 || errno != EAGAIN) closed = 1;
+                break;
+            }
+
+            if (done) {
+                if (write(fd, response, sizeof(response) - 1) > 0) served++;
+                closed = 1;
+            }
+            if (closed) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+                close(fd);
+            }
+        }
+
+        double now = now_ms();
+        if (now >= next_report) {
+            printf("[%6.0fs] served/s=%-7lu total=%lu\n",
+                   (now - start) / 1000, served - last_served, served);
+            fflush(stdout);
+            last_served = served;
+            next_report += 1000;
+        }
+    }
+
+    free(conns);
+    close(epfd);
+    close(lfd);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s -u <url> [-n agents] [-s interval] [-d duration] [-c concurrency] [-k salt] [-f format]\n"
+            "       %s -m <port>\n"
+            "  -u  上报地址（仅支持 http://，例如 wrangler dev 的 http://127.0.0.1:8787/status）\n"
+            "  -n  虚拟客户端数量（默认 1000）\n"
+            "  -s  每个客户端的上报间隔秒数（默认 10）\n"
+            "  -d  压测持续秒数（默认 60）\n"
+            "  -c  最大并发连接数（默认 256）\n"
+            "  -k  machine_id 前缀（十六进制，默认 7a73616e），相同前缀复用同一批客户端\n"
+            "  -f  上报编码：form（默认）、json、influx\n"
+            "  -m  以模拟接收端模式监听指定端口\n",
+            prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    char url[512] = "";
+    int agents = 1000;
+    int duration = 60;
+    int mock_port = 0;
+    unsigned int salt = 0x7a73616e;
+    int opt;
+
+    g_encoder = find_encoder("form");
+    while ((opt = getopt(argc, argv, "u:n:s:d:c:k:f:m:h")) != -1) {
+        switch (opt) {
+            case 'u':
+                safe_strncpy(url, optarg, sizeof(url));
+                break;
+            case 'n':
+                agents = atoi(optarg);
+                break;
+            case 's':
+                g_interval = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            case 'c':
+                g_max_conns = atoi(optarg);
+                break;
+            case 'k':
+                salt = (unsigned int)strtoul(optarg, NULL, 16);
+                break;
+            case 'f':
+                g_encoder = find_encoder(optarg);
+                if (!g_encoder) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'm':
+                mock_port = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    if (mock_port > 0) return run_mock_server(mock_port);
+
+    if (strlen(url) == 0 || agents <= 0 || g_interval <= 0 || duration <= 0 || g_max_conns <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    return run_load(url, agents, duration, salt);
+}